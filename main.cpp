@@ -1,6 +1,51 @@
 #define OLC_PGE_APPLICATION
 #include "olcPixelGameEngine.h"
 
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+// x86 builds with GCC or Clang can pick AVX2 paths at run time
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BEACH_AVX2_DISPATCH
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Bit counting and scanning on 64-bit words, by GCC/Clang builtin or MSVC intrinsic.
+// The scans want a word with a bit set.
+static inline int countBits(uint64_t bits) {
+#if defined(_MSC_VER)
+	return int(__popcnt64(bits));
+#else
+	return __builtin_popcountll(bits);
+#endif
+}
+
+static inline int lowestBit(uint64_t bits) {
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward64(&i, bits);
+	return int(i);
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+static inline int highestBit(uint64_t bits) {
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanReverse64(&i, bits);
+	return int(i);
+#else
+	return 63 - __builtin_clzll(bits);
+#endif
+}
+
 // fixed by engine
 static const int letterSize = 8;
 
@@ -68,6 +113,8 @@ static const float sunburnTime = 5.0f;
 static const float timeToRain = 15.0f;
 static const float rainRate = 50.0f;
 static const float rainFallSpeed = 2.0f;
+// most raindrops in the air at once; a steady shower keeps a few dozen
+static const int rainCapacity = 256;
 
 static const float windEventRate = 1.0f / 10.0f;
 static const float windEventDuration = 4.0f;
@@ -85,6 +132,15 @@ static const float windWoodPushRate = 1.0f/0.1f;
 // particle fall rate is inversely proportional to size of particle
 static const float particleMoveRate = 40.0f * syCellHeight / 16;
 
+// the world advances in fixed steps; after a long frame it catches up by at most
+// maxStepsPerFrame of them and lets the rest of the time go, so one slow frame can't
+// make the next one slower still
+static const float simStepTime = 1.0f / 60.0f;
+static const int maxStepsPerFrame = 4;
+
+// default time a frame may spend sweeping particles; sweeps that don't fit carry over
+static const int sweepBudgetMicros = 8000;
+
 enum ActionState {
 	Idle,
 	GettingSand,
@@ -103,260 +159,2460 @@ enum Particle {
 	DampSand
 };
 
-void swap(Particle grid[nyParticles][nxParticles], int x1, int y1, int x2, int y2) {
-	Particle t1 = grid[y1][x1];
-	Particle t2 = grid[y2][x2];
-	grid[y2][x2] = t1;
-	grid[y1][x1] = t2;
-}
-
-bool swapIfEmpty(Particle grid[nyParticles][nxParticles], int x1, int y1, int x2, int y2) {
-	if (x2 >= 0 && x2 < nxParticles && y2 >= 0 && y2 < nyParticles && grid[y2][x2] == NoParticle) {
-		swap(grid, x1, y1, x2, y2);
-		return true;
-	}
-	else {
-		return false;
-	}
-}
-
 enum CastleCell {
 	NonFullCell,
 	FullDryCell,
 	FullDampCell
 };
 
-enum BucketState {
-	BucketEmpty,
-	BucketSand,
-	BucketWater,
-	BucketDampSand,
-	BucketWood
-};
+// Cell-sized chunks of the particle grid, each of which can sleep. A sweep skips sleeping
+// chunks. Any change to a particle wakes the chunks within one particle of it, both for
+// the rest of the current sweep and for the next one, so a chunk sleeps once a whole
+// sweep has passed with nothing changing in or next to it. Settled sand can only move
+// again after a neighbour changes or the fall rules change, so sleeping loses nothing.
+// Flags are atomic because neighbouring bands of a parallel sweep can wake the same chunk.
+class ParticleChunks {
+public:
+	static const int nRowWords = (nyParticles + 63) / 64;
 
-enum GameState {
-	Normal,
-	Drowning,
-	Menu,
-	Won
-};
+	ParticleChunks() {
+		clear();
+	}
 
-class Game : public olc::PixelGameEngine
-{
-public:
-	Game()
-	{
-		sAppName = "Beach Weather";
+	// sweeps a woken chunk stays awake after the current one; engines whose rules
+	// alternate between sweeps need a quiet spell of more than one to be sure it's settled
+	void setLinger(int sweeps) {
+		linger = uint8_t(sweeps);
 	}
 
-private:
+	void clear() {
+		setAll(false);
+		for (auto& rows : changedRows) rows.store(~uint64_t(0), std::memory_order_relaxed);
+	}
 
-	float sxPlayerX = 60.0f;
-	float syPlayerY = float(syBeachMax - 1);
+	void wakeAll() {
+		setAll(true);
+	}
 
-	bool raining = false;
-	float rainCharge = 0.0f;
-	std::vector<float> wxRaindropsX;
-	std::vector<float> wyRaindropsY;
+	// wake the chunks touching the particles from (x1, y1) to (x2, y2), plus one all round
+	// every particle change comes through here, so it also marks the rows it touched
+	void wake(int x1, int y1, int x2, int y2) {
+		for (int y = std::max(std::min(y1, y2), 0); y <= std::min(std::max(y1, y2), nyParticles - 1); y++) {
+			uint64_t bit = uint64_t(1) << (y % 64);
+			if (!(changedRows[y / 64].load(std::memory_order_relaxed) & bit)) {
+				changedRows[y / 64].fetch_or(bit, std::memory_order_relaxed);
+			}
+		}
+		int cxLo = std::max(x1 - 1, 0) / sxCellWidth;
+		int cxHi = std::min(x2 + 1, nxParticles - 1) / sxCellWidth;
+		int cyLo = std::max(y1 - 1, 0) / syCellHeight;
+		int cyHi = std::min(y2 + 1, nyParticles - 1) / syCellHeight;
+		for (int cy = cyLo; cy <= cyHi; cy++) {
+			for (int cx = cxLo; cx <= cxHi; cx++) {
+				awakeNow[cy][cx].store(true, std::memory_order_relaxed);
+				sweepsLeft[cy][cx].store(linger, std::memory_order_relaxed);
+			}
+		}
+	}
 
-	bool wind;
-	float windVelocity;
+	void wake(int x, int y) {
+		wake(x, y, x, y);
+	}
 
-	bool seaRising;
-	float wySeaLevel;
+	bool awake(int cx, int cy) const {
+		return awakeNow[cy][cx].load(std::memory_order_relaxed);
+	}
 
-	ActionState actionState = Idle;
+	bool rowAwake(int cy) const {
+		for (int cx = 0; cx < nxCells; cx++) {
+			if (awake(cx, cy)) return true;
+		}
+		return false;
+	}
 
-	Particle particles[nyParticles][nxParticles];
-	CastleCell castleGrid[nyCells][nxCells];
+	// call before each sweep: a change in wind changes the fall rules everywhere
+	void startSweep(bool wind, float windVelocity) {
+		int rules = wind ? (windVelocity > 0.0f ? 1 : -1) : 0;
+		if (rules != lastRules) {
+			wakeAll();
+			lastRules = rules;
+		}
+	}
 
-	std::vector<olc::vi2d> ladders;
-	std::vector<olc::vf2d> looseLadders;
-	bool nearUpLadder;
-	bool nearDownLadder;
+	// a bit per particle row changed since the last call, then starts afresh;
+	// false if none changed
+	bool takeChangedRows(uint64_t* rows) {
+		bool any = false;
+		for (int w = 0; w < nRowWords; w++) {
+			rows[w] = changedRows[w].exchange(0, std::memory_order_relaxed);
+			any = any || rows[w] != 0;
+		}
+		return any;
+	}
 
-	std::vector<olc::vi2d> sunburnLocations;
-	std::vector<float> sunburnTimes;
+	void endSweep() {
+		for (int cy = 0; cy < nyCells; cy++) {
+			for (int cx = 0; cx < nxCells; cx++) {
+				uint8_t left = sweepsLeft[cy][cx].load(std::memory_order_relaxed);
+				awakeNow[cy][cx].store(left > 0, std::memory_order_relaxed);
+				sweepsLeft[cy][cx].store(left > 0 ? left - 1 : 0, std::memory_order_relaxed);
+			}
+		}
+	}
 
-	int cxPlayerX;
-	int cyPlayerY;
+private:
+	std::atomic<bool> awakeNow[nyCells][nxCells];
+	std::atomic<uint8_t> sweepsLeft[nyCells][nxCells];
+	std::atomic<uint64_t> changedRows[nRowWords];
+	uint8_t linger = 1;
+	int lastRules = 0;
+
+	void setAll(bool awake) {
+		for (int cy = 0; cy < nyCells; cy++) {
+			for (int cx = 0; cx < nxCells; cx++) {
+				awakeNow[cy][cx].store(awake, std::memory_order_relaxed);
+				sweepsLeft[cy][cx].store(awake ? linger : 0, std::memory_order_relaxed);
+			}
+		}
+	}
+};
 
-	void drawCrenel(int sx, int sy) {
-		// fill one extra line dark yellow height to overwrite "lid" of the block
-		FillRect(sx + 1, sy - syCrenelHeight, sxCrenelWidth - 2, syCrenelHeight + 1, olc::DARK_YELLOW);
-		DrawLine(sx, sy - syCrenelHeight, sx, sy - 1, olc::VERY_DARK_YELLOW);
-		DrawLine(sx + sxCrenelWidth - 1, sy - syCrenelHeight, sx + sxCrenelWidth - 1, sy - 1, olc::VERY_DARK_YELLOW);
-		DrawLine(sx, sy - syCrenelHeight, sx + sxCrenelWidth - 1, sy - syCrenelHeight, olc::VERY_DARK_YELLOW);
+// Dry and damp particle counts for each cell, kept by the engines as particles move and
+// change, so a cell's castle state is read off without scanning its particles. A cell is
+// full when it has no empty particles, and damp when it is full of damp sand. Counts are
+// atomic because the block engine's threads can move sand into the same cell at once.
+class CellCounts {
+public:
+	// changed cells are numbered column by column from the top left, as in CellSet
+	static const int nChangedWords = (nxCells * nyCells + 63) / 64;
+
+	CellCounts() {
+		clear();
 	}
 
-	void updateCellFromParticles(int cx, int cy) {
-		int sTop = cy * syCellHeight;
-		int sLeft = cx * sxCellWidth;
-		Particle firstParticle = particles[sTop][sLeft];
-		if (firstParticle == NoParticle) {
-			castleGrid[cy][cx] = NonFullCell;
-		}
-		else {
-			Particle cellType = firstParticle;
-			for (int x = 0; x < sxCellWidth; x++) {
-				for (int y = 0; y < syCellHeight; y++) {
-					cellType = std::min(cellType, particles[sTop + y][sLeft + x]);
-				}
-			}
-			switch (cellType) {
-			case NoParticle:
-				castleGrid[cy][cx] = NonFullCell;
-				break;
-			case DrySand:
-				castleGrid[cy][cx] = FullDryCell;
-				break;
-			case DampSand:
-				castleGrid[cy][cx] = FullDampCell;
-				break;
+	void clear() {
+		for (int cy = 0; cy < nyCells; cy++) {
+			for (int cx = 0; cx < nxCells; cx++) {
+				dry[cy][cx].store(0, std::memory_order_relaxed);
+				damp[cy][cx].store(0, std::memory_order_relaxed);
 			}
 		}
+		for (auto& cells : changedCells) cells.store(~uint64_t(0), std::memory_order_relaxed);
 	}
 
+	void add(int cx, int cy, int dDry, int dDamp) {
+		if (dDry == 0 && dDamp == 0) return;
+		if (dDry != 0) dry[cy][cx].fetch_add(dDry, std::memory_order_relaxed);
+		if (dDamp != 0) damp[cy][cx].fetch_add(dDamp, std::memory_order_relaxed);
+		int i = cx * nyCells + cy;
+		uint64_t bit = uint64_t(1) << (i % 64);
+		if (!(changedCells[i / 64].load(std::memory_order_relaxed) & bit)) {
+			changedCells[i / 64].fetch_or(bit, std::memory_order_relaxed);
+		}
+	}
 
-	BucketState bucket;
+	// a bit per cell whose counts changed since the last call, then starts afresh;
+	// false if none changed
+	bool takeChanged(uint64_t* cells) {
+		bool any = false;
+		for (int w = 0; w < nChangedWords; w++) {
+			cells[w] = changedCells[w].exchange(0, std::memory_order_relaxed);
+			any = any || cells[w] != 0;
+		}
+		return any;
+	}
 
-	float sunburnEventCharge;
-	float windEventCharge;
-	float windEventStopCharge;
-	float particleMoveCharge;
-	float rainTimer;
+	// the particle at (x, y) turned from one kind into another
+	void change(int x, int y, Particle from, Particle to) {
+		add(x / sxCellWidth, y / syCellHeight, int(to == DrySand) - int(from == DrySand), int(to == DampSand) - int(from == DampSand));
+	}
 
-	bool tideCounting;
-	float tideTimer;
-	bool displayingTideEvent;
-	float tideEventDisplayTimer;
+	// a particle p moved from (x1, y1) to (x2, y2); only crossing into another cell counts
+	void move(int x1, int y1, int x2, int y2, Particle p) {
+		int cx1 = x1 / sxCellWidth;
+		int cy1 = y1 / syCellHeight;
+		int cx2 = x2 / sxCellWidth;
+		int cy2 = y2 / syCellHeight;
+		if (cx1 == cx2 && cy1 == cy2) return;
+		add(cx1, cy1, -int(p == DrySand), -int(p == DampSand));
+		add(cx2, cy2, int(p == DrySand), int(p == DampSand));
+	}
 
-	float windWoodPushCharge;
+	CastleCell cell(int cx, int cy) const {
+		int nDry = dry[cy][cx].load(std::memory_order_relaxed);
+		int nDamp = damp[cy][cx].load(std::memory_order_relaxed);
+		if (nDry + nDamp < sxCellWidth * syCellHeight) return NonFullCell;
+		return nDry > 0 ? FullDryCell : FullDampCell;
+	}
 
-	int fallPreference;
+private:
+	std::atomic<int> dry[nyCells][nxCells];
+	std::atomic<int> damp[nyCells][nxCells];
+	std::atomic<uint64_t> changedCells[nChangedWords];
+};
 
-	GameState gameState = Menu;
+// How far up each column the tide has already wetted: below its mark a column holds no
+// dry sand, so wetFrom only has to look at rows the sea has newly reached. Dry sand that
+// lands on or below a column's mark, whether poured there or fallen in, pulls the mark up
+// to just below it, so it is wetted next time along with anything above. Marks are atomic
+// because parallel bands can drop sand into the same column.
+class WetMarks {
+public:
+	WetMarks() {
+		clear();
+	}
 
-	void resetGameVariables(bool menu = false) {
-		sxPlayerX = 60.0f;
-		syPlayerY = float(syBeachMax - 1);
+	void clear() {
+		for (int x = 0; x < nxParticles; x++) {
+			marks[x].store(nyParticles, std::memory_order_relaxed);
+		}
+		lowest = nyParticles;
+	}
 
-		raining = false;
-		rainCharge = 0.0f;
+	// whether dry sand arriving in row y might be under a mark
+	bool mayCover(int y) const {
+		return y >= lowest;
+	}
 
-		wxRaindropsX.clear();
-		wyRaindropsY.clear();
+	void dryAt(int x, int y) {
+		int mark = marks[x].load(std::memory_order_relaxed);
+		while (y >= mark && !marks[x].compare_exchange_weak(mark, y + 1, std::memory_order_relaxed)) {}
+	}
 
-		wind = false;
-		windVelocity = windSpeed;
+	// move column x's mark down to syTop, returning the old one: rows syTop up to it need wetting
+	int lower(int x, int syTop) {
+		int mark = marks[x].load(std::memory_order_relaxed);
+		if (syTop < mark) marks[x].store(syTop, std::memory_order_relaxed);
+		lowest = std::min(lowest, syTop);
+		return mark;
+	}
 
-		seaRising = false;
-		wySeaLevel = wySeaStart;
-		displayingTideEvent = false;
-		tideEventDisplayTimer = 0.0f;
+private:
+	std::atomic<int> marks[nxParticles];
+	// no mark is above this
+	int lowest;
+};
 
-		windWoodPushCharge = 0.0f;
+// Game streams; sweeps number theirs from FirstSweepStream on
+enum RandomStreamId {
+	SunburnStream,
+	WindStream,
+	RainStream,
+	FirstSweepStream
+};
 
-		actionState = Idle;
+// Random numbers for the whole game from one seed. The nth value of a stream is a
+// SplitMix64 hash of the seed, the stream number and n, so streams share no state and
+// any value can be drawn on its own: each subsystem, and each row of each sweep, gets
+// its own stream, on whatever thread, and a run replays exactly from the seed.
+class RandomStream {
+public:
+	RandomStream(uint64_t seed = 0, uint64_t stream = 0) : key(mix(seed + gamma * (stream + 1))) {}
 
-		for (int y = 0; y < nyParticles; y++) {
-			for (int x = 0; x < nxParticles; x++) {
-				particles[y][x] = NoParticle;
-			}
+	uint64_t at(uint64_t n) const {
+		return mix(key + gamma * (n + 1));
+	}
+
+	uint64_t next() {
+		return at(counter++);
+	}
+
+	// coin flips come from a buffered word, since the fall rules need a lot of them
+	int bit() {
+		if (nBits == 0) {
+			bits = next();
+			nBits = 64;
 		}
-		for (int y = 0; y < nyCells; y++) {
-			for (int x = 0; x < nxCells; x++) {
-				castleGrid[y][x] = NonFullCell;
+		int b = int(bits & 1);
+		bits >>= 1;
+		nBits--;
+		return b;
+	}
+
+	// uniform in [0, 1)
+	float unit() {
+		return float(next() >> 40) / float(1 << 24);
+	}
+
+private:
+	static const uint64_t gamma = 0x9E3779B97F4A7C15ull;
+	uint64_t key;
+	uint64_t counter = 0;
+	uint64_t bits = 0;
+	int nBits = 0;
+
+	static uint64_t mix(uint64_t z) {
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+};
+
+// A fixed pool of threads that share out numbered jobs; the calling thread joins in.
+// run() returns once every job is done and every worker is idle again.
+class SweepWorkers {
+public:
+	~SweepWorkers() {
+		resize(1);
+	}
+
+	// threads taking part in run(), counting the caller
+	void resize(int threads) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wakeWorkers.notify_all();
+		for (auto& t : pool) t.join();
+		pool.clear();
+		quit = false;
+		for (int i = 1; i < threads; i++) {
+			pool.emplace_back(&SweepWorkers::work, this, generation);
+		}
+	}
+
+	void run(int jobs, const std::function<void(int)>& job) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			task = &job;
+			nJobs = jobs;
+			nextJob = 0;
+			busyWorkers = int(pool.size());
+			generation++;
+		}
+		wakeWorkers.notify_all();
+		drain();
+		std::unique_lock<std::mutex> lock(mutex);
+		workersIdle.wait(lock, [&] { return busyWorkers == 0; });
+	}
+
+private:
+	std::vector<std::thread> pool;
+	std::mutex mutex;
+	std::condition_variable wakeWorkers;
+	std::condition_variable workersIdle;
+	const std::function<void(int)>* task = nullptr;
+	int nJobs = 0;
+	std::atomic<int> nextJob{ 0 };
+	int busyWorkers = 0;
+	uint64_t generation = 0;
+	bool quit = false;
+
+	void drain() {
+		for (int j = nextJob++; j < nJobs; j = nextJob++) {
+			(*task)(j);
+		}
+	}
+
+	void work(uint64_t seen) {
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeWorkers.wait(lock, [&] { return quit || generation != seen; });
+				if (quit) return;
+				seen = generation;
 			}
+			drain();
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busyWorkers == 0) workersIdle.notify_all();
 		}
-		if (menu) {
-			for (int cx = nxCells / 2; cx < nxCells / 2 + 3; cx++) {
-				castleGrid[nyCells - 1][cx] = FullDampCell;
-				for (int x = cx*sxCellWidth; x < (cx + 1) * sxCellWidth; x++) {
-					for (int y = (nyCells - 1) * syCellHeight; y < nyCells * syCellHeight; y++) {
-						particles[y][x] = DampSand;
-					}
-				}
+	}
+};
+
+// Particle engines. Each one holds the sand of the build area behind the same members,
+// so the game is written once against ParticleGrid:
+//   clear()                    empty the grid
+//   get(x, y), set(x, y, p)    single particle access
+//   wetFrom(y)                 dry sand in rows y and below becomes damp
+//   sweep(wind, windVelocity)  one fall step over the awake chunks of the grid
+//   beginSweep(wind, windVelocity), sweepSlice(i) for i from 0 to sweepSlices() - 1,
+//   finishSweep()              the same step in slices, to spread it over frames
+//   setThreads(n)              sweep on n threads, 0 for serial (the bit-plane
+//                              engine ignores it)
+//   setSeed(seed)              where sweeps draw their random streams from
+//   cell(cx, cy)               castle state of a cell, from its particle counts
+//   takeChangedCells(cells)    cells whose counts changed since last asked
+// Each keeps a ParticleChunks, woken by its own moves and by set and wetFrom, a
+// CellCounts, updated by the same, and WetMarks, so wetFrom skips rows already wet.
+// The engine is chosen at build time: define BEACH_PARTICLES_BITPLANE for the
+// bit-plane engine or BEACH_PARTICLES_MARGOLUS for the block engine, otherwise the
+// original in-place scan is used.
+
+// Storage for the engines that keep one particle per cell, a byte each. A border one cell
+// wide all round always reads as Blocked, so probing a neighbour needs no bounds check.
+class ParticleCells {
+public:
+	static const uint8_t Blocked = 3;
+
+	ParticleCells() {
+		for (int y = 0; y < nyParticles + 2; y++) {
+			for (int x = 0; x < nxParticles + 2; x++) {
+				cells[y][x] = Blocked;
 			}
-			castleGrid[nyCells - 2][nxCells / 2 + 1] = FullDampCell;
-			for (int x = (nxCells/2 + 1) * sxCellWidth; x < (nxCells/2 + 2) * sxCellWidth; x++) {
-				for (int y = (nyCells - 2) * syCellHeight; y < (nyCells - 1) * syCellHeight; y++) {
-					particles[y][x] = DampSand;
+		}
+		clear();
+	}
+
+	void clear() {
+		for (int y = 0; y < nyParticles; y++) {
+			std::fill(row(y), row(y) + nxParticles, uint8_t(NoParticle));
+		}
+		chunks.clear();
+		counts.clear();
+		marks.clear();
+	}
+
+	Particle get(int x, int y) const {
+		return Particle(row(y)[x]);
+	}
+
+	void set(int x, int y, Particle p) {
+		if (row(y)[x] != p) {
+			counts.change(x, y, Particle(row(y)[x]), p);
+			row(y)[x] = p;
+			if (p == DrySand) marks.dryAt(x, y);
+			chunks.wake(x, y);
+		}
+	}
+
+	CastleCell cell(int cx, int cy) const {
+		return counts.cell(cx, cy);
+	}
+
+	// row y as a Particle byte per column; engines that store it otherwise unpack it
+	// into scratch
+	const uint8_t* rowBytes(int y, uint8_t*) const {
+		return row(y);
+	}
+
+	bool takeChangedRows(uint64_t* rows) {
+		return chunks.takeChangedRows(rows);
+	}
+
+	bool takeChangedCells(uint64_t* cells) {
+		return counts.takeChanged(cells);
+	}
+
+	void wetFrom(int syTop) {
+		syTop = std::max(syTop, 0);
+		for (int x = 0; x < nxParticles; x++) {
+			int yEnd = marks.lower(x, syTop);
+			for (int y = syTop; y < yEnd; y++) {
+				if (row(y)[x] == DrySand) {
+					row(y)[x] = DampSand;
+					counts.change(x, y, DrySand, DampSand);
+					chunks.wake(x, y);
 				}
 			}
 		}
+	}
 
-		ladders.clear();
-		looseLadders.clear();
-		nearUpLadder = false;
-		nearDownLadder = false;
+protected:
+	uint8_t cells[nyParticles + 2][nxParticles + 2];
+	ParticleChunks chunks;
+	CellCounts counts;
+	WetMarks marks;
 
-		sunburnLocations.clear();
-		sunburnTimes.clear();
+	// particle row y, indexable from -1 to nxParticles
+	uint8_t* row(int y) {
+		return cells[y + 1] + 1;
+	}
 
-		tideCounting = true;
-		tideTimer = 0.0f;
+	const uint8_t* row(int y) const {
+		return cells[y + 1] + 1;
+	}
 
-		rainTimer = 0.0f;
+	bool moveIfEmpty(int x1, int y1, int x2, int y2) {
+		uint8_t& to = row(y2)[x2];
+		if (to != NoParticle) return false;
+		uint8_t& from = row(y1)[x1];
+		to = from;
+		from = NoParticle;
+		counts.move(x1, y1, x2, y2, Particle(to));
+		if (to == DrySand && marks.mayCover(y2)) marks.dryAt(x2, y2);
+		chunks.wake(std::min(x1, x2), y1, std::max(x1, x2), y2);
+		return true;
+	}
+};
 
-		bucket = BucketEmpty;
+// original engine: rows swept bottom-up in place, one particle at a time
+class ScanParticles : public ParticleCells {
+public:
+	// The sweep runs in horizontal bands, one chunk row each: first every even band,
+	// then every odd band, so that bands in the same phase are always a band apart and
+	// never touch the same rows. A particle standing on one in the band below that has
+	// yet to move is held back until that band has gone, so it falls as it would in a
+	// sweep from the bottom up. With threads set, each phase's bands run at once;
+	// without, they run one after another in the same order. Each row draws from its own
+	// stream, numbered by sweep and row, so the result depends on the seed alone and is
+	// the same whatever the number of threads, none included.
+	void setThreads(int threads) {
+		bandThreads = threads;
+		workers.resize(std::max(threads, 1));
+	}
 
-		sunburnEventCharge = 0.0f;
-		windEventCharge = 0.0f;
-		windEventStopCharge = 0.0f;
-		particleMoveCharge = 0.0f;
+	void setSeed(uint64_t seed) {
+		randomSeed = seed;
+		sweeps = 0;
 	}
 
-	const int sxBucketWidth = 3 * sxCrenelOffset + sxCrenelWidth;
-	const int syBucketHeight = syScreenHeight - syBeachMax - 1;
+	// if wind blowing, dry sand can move to the downwind side
+	void sweep(bool wind, float windVelocity) {
+		beginSweep(wind, windVelocity);
+		for (int slice = 0; slice < sweepSlices(); slice++) {
+			sweepSlice(slice);
+		}
+		finishSweep();
+	}
 
-	void FillBucket(olc::Pixel pixel) {
-		FillRect(sxScreenWidth - sxBucketWidth + 1, syBeachMax + 1, sxBucketWidth - 2, syBucketHeight - 1, pixel);
+	void beginSweep(bool wind, float windVelocity) {
+		chunks.startSweep(wind, windVelocity);
+		sweepWind = wind;
+		sweepWindVelocity = windVelocity;
 	}
 
-	void FillKey(int x, int y, olc::Pixel pixel, std::string letter, bool valid) {
-		DrawRect(x, y, sxKeyWidth, syKeyHeight, olc::GREY);
-		if (valid) {
-			FillRect(x + 1, y + 1, sxKeyWidth - 1, syKeyHeight - 1, pixel);
-			DrawString(x + (sxKeyWidth - 1) / 2 - letterSize / 2 + 1, y + (syKeyHeight - 1) / 2 - letterSize / 2 + 1, letter);
+	// serial sweeps go a band at a time, threaded ones a phase at a time
+	int sweepSlices() const {
+		return bandThreads == 0 ? nyCells : 2;
+	}
+
+	void sweepSlice(int slice) {
+		if (bandThreads == 0) {
+			// the even bands from the top, then the odd ones
+			int nEven = (nyCells + 1) / 2;
+			int band = slice < nEven ? 2 * slice : 2 * (slice - nEven) + 1;
+			sweepBand(band, sweepWind, sweepWindVelocity);
 		}
 		else {
-			DrawString(x + (sxKeyWidth - 1) / 2 - letterSize / 2 + 1, y + (syKeyHeight - 1) / 2 - letterSize / 2 + 1, letter, olc::GREY);
+			eachBand(slice, [&](int band) { sweepBand(band, sweepWind, sweepWindVelocity); });
 		}
+		if (slice == sweepSlices() - 1) releaseHeld(sweepWind, sweepWindVelocity);
 	}
 
-	void writeCentred(int x, int y, std::string s) {
-		int left = x - letterSize*s.length()/2 - 1;
-		int up = y - letterSize / 2 - 1;
-		DrawString(left, up, s);
+	void finishSweep() {
+		sweeps++;
+		chunks.endSweep();
 	}
 
-	void dropLadder() {
-		looseLadders.push_back(olc::vf2d(
-			sxPlayerX + sxPlayerWidth / 2 - sxCellsOffset / 2,
-			syPlayerY - syCellHeight / 4 + 1
-		));
+private:
+	int bandThreads = 0;
+	uint64_t randomSeed = 0;
+	uint64_t sweeps = 0;
+	bool sweepWind = false;
+	float sweepWindVelocity = 0.0f;
+	SweepWorkers workers;
+	// columns of each band's top row filled from the band above during this sweep
+	bool arrivals[nyCells][nxParticles];
+	// particles held this sweep for the band below them, and the rows and bands holding
+	// any; a row's columns are only kept up while it holds some
+	bool held[nyParticles][nxParticles];
+	bool rowHeld[nyParticles];
+	bool bandHeld[nyCells];
+	// each row's stream this sweep, which its held particles draw on from
+	RandomStream rowRandom[nyParticles];
+
+	// job(band) for every band of the phase, all at once when threaded
+	void eachBand(int phase, const std::function<void(int)>& job) {
+		int nBands = (nyCells + 1 - phase) / 2;
+		if (bandThreads == 0) {
+			for (int i = 0; i < nBands; i++) job(2 * i + phase);
+		}
+		else {
+			workers.run(nBands, [&](int i) { job(2 * i + phase); });
+		}
+	}
+
+	// Even bands go before the odd band below them, so sand they drop into its top row
+	// is noted and left alone when that band runs, as a row's own sweep would. Their
+	// bottom row goes before that top row, though, so a particle there standing on
+	// another is held until the odd band has gone, rather than sliding off one that has
+	// yet to move, and so is everything stacked on a held particle, up into the odd band
+	// above.
+	void sweepBand(int band, bool wind, float windVelocity) {
+		int phase = band % 2;
+		int yTop = band * syCellHeight;
+		int yBottom = yTop + syCellHeight - 1;
+		bandHeld[band] = false;
+		if (!chunks.rowAwake(band)) {
+			// nothing in it moves, so nothing is held and nothing drops into the band below
+			std::fill(rowHeld + yTop, rowHeld + yBottom + 1, false);
+			if (phase == 0 && band < nyCells - 1) {
+				std::fill(arrivals[band + 1], arrivals[band + 1] + nxParticles, false);
+			}
+			return;
+		}
+		for (int y = yBottom; y >= yTop; y--) {
+			bool aboveBand = phase == 0 && y == yBottom && band < nyCells - 1;
+			const bool* arrived = phase == 1 && y == yTop ? arrivals[band] : nullptr;
+			uint8_t below[nxParticles];
+			if (aboveBand) {
+				std::copy(row(y + 1), row(y + 1) + nxParticles, below);
+			}
+			bool skip[nxParticles];
+			rowHeld[y] = false;
+			if (aboveBand || (y < nyParticles - 1 && rowHeld[y + 1])) {
+				for (int x = 0; x < nxParticles; x++) {
+					bool arrivedHere = arrived && arrived[x];
+					bool holds = false;
+					if (row(y)[x] != NoParticle && !arrivedHere) {
+						holds = aboveBand ? below[x] != NoParticle && chunks.awake(x / sxCellWidth, band) : held[y + 1][x];
+					}
+					held[y][x] = holds;
+					rowHeld[y] |= holds;
+					skip[x] = holds || arrivedHere;
+				}
+			}
+			bandHeld[band] |= rowHeld[y];
+			sweepRow(y, wind, windVelocity, rowHeld[y] ? skip : arrived);
+			if (aboveBand) {
+				for (int x = 0; x < nxParticles; x++) {
+					arrivals[band + 1][x] = below[x] == NoParticle && row(y + 1)[x] != NoParticle;
+				}
+			}
+		}
+	}
+
+	// Held particles go in rounds, the even bands and then the odd ones, each band
+	// bottom-up as in the sweep. One still standing on a held particle of the band below
+	// waits for the next round; the lowest held always go, so the rounds run out.
+	void releaseHeld(bool wind, float windVelocity) {
+		while (std::any_of(bandHeld, bandHeld + nyCells, [](bool h) { return h; })) {
+			for (int phase = 0; phase < 2; phase++) {
+				eachBand(phase, [&](int band) { releaseBand(band, wind, windVelocity); });
+			}
+		}
+	}
+
+	void releaseBand(int band, bool wind, float windVelocity) {
+		if (!bandHeld[band]) return;
+		bandHeld[band] = false;
+		int yTop = band * syCellHeight;
+		for (int y = yTop + syCellHeight - 1; y >= yTop; y--) {
+			if (!rowHeld[y]) continue;
+			bool belowHeld = y < nyParticles - 1 && rowHeld[y + 1];
+			bool skip[nxParticles];
+			bool released = false;
+			rowHeld[y] = false;
+			for (int x = 0; x < nxParticles; x++) {
+				bool stays = held[y][x] && belowHeld && held[y + 1][x];
+				skip[x] = !held[y][x] || stays;
+				released |= !skip[x];
+				held[y][x] = stays;
+				rowHeld[y] |= stays;
+			}
+			bandHeld[band] |= rowHeld[y];
+			if (released) releaseRow(y, wind, windVelocity, skip);
+		}
+	}
+
+	// one row of the sweep, leaving alone the particles in skipped columns: those that
+	// already fell into it this sweep, or are held for the band below
+	void sweepRow(int y, bool wind, float windVelocity, const bool* skip) {
+		int cy = y / syCellHeight;
+		if (!chunks.rowAwake(cy)) return;
+		if (wind) {
+			sweepWindyRow(y, windVelocity > 0.0f ? 1 : -1, skip);
+			return;
+		}
+		RandomStream random(randomSeed, FirstSweepStream + sweeps * nyParticles + y);
+		int updateDirection = random.bit();
+		for (int x = (nxParticles - 1) * updateDirection; x >= 0 && x < nxParticles; x += 1 - 2*updateDirection) {
+			if (!chunks.awake(x / sxCellWidth, cy)) {
+				// jump to the far edge of the sleeping chunk
+				x = updateDirection ? x - x % sxCellWidth : x - x % sxCellWidth + sxCellWidth - 1;
+				continue;
+			}
+			if (skip && skip[x]) continue;
+			fall(x, y, 2*random.bit() - 1);
+		}
+		rowRandom[y] = random;
+	}
+
+	// row y again for the particles held in it, the rest skipped, drawing on from where
+	// its sweep left off
+	void releaseRow(int y, bool wind, float windVelocity, const bool* skip) {
+		if (wind) {
+			sweepWindyRow(y, windVelocity > 0.0f ? 1 : -1, skip);
+			return;
+		}
+		int cy = y / syCellHeight;
+		RandomStream& random = rowRandom[y];
+		int updateDirection = random.bit();
+		for (int x = (nxParticles - 1) * updateDirection; x >= 0 && x < nxParticles; x += 1 - 2*updateDirection) {
+			if (!skip[x] && chunks.awake(x / sxCellWidth, cy)) {
+				fall(x, y, 2*random.bit() - 1);
+			}
+		}
+	}
+
+	// one particle's move without wind, trying the diagonal on the fallPreference side
+	// (+1 right, -1 left) first
+	void fall(int x, int y, int fallPreference) {
+		const uint8_t* here = row(y);
+		bool leftDamp = here[x - 1] == DampSand;
+		bool rightDamp = here[x + 1] == DampSand;
+		switch(here[x]) {
+		case DrySand:
+			if (!moveIfEmpty(x, y, x, y + 1)) {
+				if (!moveIfEmpty(x, y, x + fallPreference, y + 1)) {
+					moveIfEmpty(x, y, x - fallPreference, y + 1);
+				}
+			}
+			break;
+		case DampSand:
+			if (!moveIfEmpty(x, y, x, y + 1)) {
+				if (!leftDamp && !rightDamp) {
+					if (!moveIfEmpty(x, y, x + fallPreference, y + 1)) {
+						moveIfEmpty(x, y, x - fallPreference, y + 1);
+					}
+				}
+			}
+			break;
+		}
+	}
+
+	// With wind the row is swept downwind and nothing is random. A particle can only move
+	// into an empty cell below it, diagonally below it or, for dry sand, the next one
+	// downwind. Cells below only fill up as the row goes, and the downwind one is swept
+	// after it, so a particle with none of those empty before the row starts stays put.
+	// Those that might move are found for the whole row at once, and only they are swept,
+	// in the same order and with the same moves as a particle-by-particle scan.
+	void sweepWindyRow(int y, int downwind, const bool* skip) {
+		int cy = y / syCellHeight;
+		uint64_t movers[moverWords];
+		findMovers(y, downwind, movers);
+		int x = downwind > 0 ? 0 : nxParticles - 1;
+		while ((x = nextMover(movers, x, downwind)) >= 0) {
+			if (!chunks.awake(x / sxCellWidth, cy)) {
+				// on to the near edge of the next chunk
+				x = downwind > 0 ? x - x % sxCellWidth + sxCellWidth : x - x % sxCellWidth - 1;
+				continue;
+			}
+			if (!(skip && skip[x])) {
+				// a slider is met again where it lands, wherever it started
+				while (windyStep(x, y, downwind)) x += downwind;
+			}
+			x += downwind;
+		}
+	}
+
+	static const int moverWords = (nxParticles + 63) / 64;
+
+	// bit x set where row y's particle at x has somewhere empty to go
+	void findMovers(int y, int downwind, uint64_t* movers) const {
+		const uint8_t* here = row(y);
+		const uint8_t* below = row(y + 1);
+		const uint8_t* ahead = here + downwind;
+		for (int w = 0; w < moverWords; w++) movers[w] = 0;
+		int x = 0;
+#if defined(__SSE2__)
+		// sixteen columns at a time; the border makes the reads either side safe
+		const __m128i empty = _mm_setzero_si128();
+		const __m128i dry = _mm_set1_epi8(DrySand);
+		for (; x + 16 <= nxParticles; x += 16) {
+			__m128i p = _mm_loadu_si128((const __m128i*)(here + x));
+			__m128i open = _mm_or_si128(
+				_mm_or_si128(
+					_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(below + x - 1)), empty),
+					_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(below + x)), empty)),
+				_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(below + x + 1)), empty));
+			__m128i slide = _mm_and_si128(
+				_mm_cmpeq_epi8(p, dry),
+				_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(ahead + x)), empty));
+			__m128i mover = _mm_andnot_si128(_mm_cmpeq_epi8(p, empty), _mm_or_si128(open, slide));
+			movers[x / 64] |= uint64_t(uint16_t(_mm_movemask_epi8(mover))) << (x % 64);
+		}
+#endif
+		for (; x < nxParticles; x++) {
+			bool open = below[x - 1] == NoParticle || below[x] == NoParticle || below[x + 1] == NoParticle;
+			bool slide = here[x] == DrySand && ahead[x] == NoParticle;
+			if (here[x] != NoParticle && (open || slide)) movers[x / 64] |= uint64_t(1) << (x % 64);
+		}
+	}
+
+	// the first mover from x on, going in direction dir, or -1
+	static int nextMover(const uint64_t* movers, int x, int dir) {
+		if (x < 0 || x >= nxParticles) return -1;
+		if (dir > 0) {
+			for (int w = x / 64; w < moverWords; w++) {
+				uint64_t m = w == x / 64 ? movers[w] >> (x % 64) << (x % 64) : movers[w];
+				if (m) return 64 * w + lowestBit(m);
+			}
+		}
+		else {
+			for (int w = x / 64; w >= 0; w--) {
+				uint64_t m = w == x / 64 ? movers[w] << (63 - x % 64) >> (63 - x % 64) : movers[w];
+				if (m) return 64 * w + highestBit(m);
+			}
+		}
+		return -1;
+	}
+
+	// one particle of a windy sweep; true if it slid downwind along the row
+	bool windyStep(int x, int y, int downwind) {
+		const uint8_t* here = row(y);
+		switch (here[x]) {
+		case DrySand:
+			if (moveIfEmpty(x, y, x + downwind, y + 1)) return false;
+			if (moveIfEmpty(x, y, x, y + 1)) return false;
+			if (moveIfEmpty(x, y, x + downwind, y)) return true;
+			moveIfEmpty(x, y, x - downwind, y + 1);
+			return false;
+		case DampSand:
+			if (moveIfEmpty(x, y, x, y + 1)) return false;
+			if (here[x - 1] != DampSand && here[x + 1] != DampSand) {
+				if (!moveIfEmpty(x, y, x + downwind, y + 1)) {
+					moveIfEmpty(x, y, x - downwind, y + 1);
+				}
+			}
+			return false;
+		}
+		return false;
+	}
+};
+
+// bit-plane engine: occupancy and dampness packed 64 columns to a word, column x in
+// bit x % 64 of word x / 64. Each row resolves its falls as a few whole-row bitwise
+// phases instead of probing one particle at a time. Occupancy bits past the last column
+// are always set, so nothing slides off the right edge.
+class BitPlaneParticles {
+public:
+	static const int nWords = (nxParticles + 63) / 64;
+
+	BitPlaneParticles() {
+		for (int w = 0; w < nWords; w++) {
+			fullRow[w] = ~uint64_t(0);
+			scratchRow[w] = 0;
+		}
+		clear();
+	}
+
+	void clear() {
+		for (int y = 0; y < nyParticles; y++) {
+			for (int w = 0; w < nWords; w++) {
+				occupied[y][w] = ~validMask(w);
+				damp[y][w] = 0;
+			}
+		}
+		chunks.clear();
+		counts.clear();
+		marks.clear();
+	}
+
+	Particle get(int x, int y) const {
+		uint64_t bit = uint64_t(1) << (x % 64);
+		if (!(occupied[y][x / 64] & bit)) return NoParticle;
+		return (damp[y][x / 64] & bit) ? DampSand : DrySand;
+	}
+
+	void set(int x, int y, Particle p) {
+		if (get(x, y) == p) return;
+		counts.change(x, y, get(x, y), p);
+		chunks.wake(x, y);
+		uint64_t bit = uint64_t(1) << (x % 64);
+		occupied[y][x / 64] &= ~bit;
+		damp[y][x / 64] &= ~bit;
+		if (p != NoParticle) occupied[y][x / 64] |= bit;
+		if (p == DampSand) damp[y][x / 64] |= bit;
+		if (p == DrySand) marks.dryAt(x, y);
+	}
+
+	// sweeps always run on the calling thread
+	void setThreads(int) {}
+
+	void setSeed(uint64_t seed) {
+		randomSeed = seed;
+		sweeps = 0;
+	}
+
+	CastleCell cell(int cx, int cy) const {
+		return counts.cell(cx, cy);
+	}
+
+	bool takeChangedRows(uint64_t* rows) {
+		return chunks.takeChangedRows(rows);
+	}
+
+	bool takeChangedCells(uint64_t* cells) {
+		return counts.takeChanged(cells);
+	}
+
+	const uint8_t* rowBytes(int y, uint8_t* scratch) const {
+		// eight columns at a time: a byte of 1s for occupied, plus 1 more where damp
+		static const struct Spread {
+			uint64_t bytes[256];
+			Spread() {
+				for (int b = 0; b < 256; b++) {
+					bytes[b] = 0;
+					for (int i = 0; i < 8; i++) bytes[b] |= uint64_t((b >> i) & 1) << (8 * i);
+				}
+			}
+		} spread;
+		for (int x = 0; x < nxParticles; x += 8) {
+			int occ = int(occupied[y][x / 64] >> (x % 64)) & 0xff;
+			int dmp = int(damp[y][x / 64] >> (x % 64)) & occ;
+			uint64_t eight = spread.bytes[occ] * DrySand + spread.bytes[dmp] * (DampSand - DrySand);
+			std::memcpy(scratch + x, &eight, 8);
+		}
+		return scratch;
+	}
+
+	// whole rows at a time, down to the lowest of the old marks
+	void wetFrom(int syTop) {
+		syTop = std::max(syTop, 0);
+		int yEnd = syTop;
+		for (int x = 0; x < nxParticles; x++) {
+			yEnd = std::max(yEnd, marks.lower(x, syTop));
+		}
+		for (int y = syTop; y < yEnd; y++) {
+			Row wetted;
+			for (int w = 0; w < nWords; w++) {
+				wetted[w] = occupied[y][w] & validMask(w) & ~damp[y][w];
+				damp[y][w] |= wetted[w];
+			}
+			for (int cx = 0; cx < nxCells; cx++) {
+				int n = countBetween(wetted, cx * sxCellWidth, (cx + 1) * sxCellWidth);
+				counts.add(cx, y / syCellHeight, -n, n);
+			}
+			wakeChanged(y, wetted);
+		}
+	}
+
+	// Same rules as the scan engine, applied to a row at a time: straight falls first,
+	// then diagonal slides on each particle's preferred side, then the other side.
+	// Moves within one phase never share a target, and each phase sees the row below
+	// as left by the previous one. With wind, dry sand prefers the downwind diagonal,
+	// then straight down, then sliding downwind along the row; sliders keep going until
+	// they drop or stop, as they do when the scan follows them along the row.
+	void sweep(bool wind, float windVelocity) {
+		beginSweep(wind, windVelocity);
+		for (int slice = 0; slice < sweepSlices(); slice++) {
+			sweepSlice(slice);
+		}
+		finishSweep();
+	}
+
+	void beginSweep(bool wind, float windVelocity) {
+		chunks.startSweep(wind, windVelocity);
+		sweepWind = wind;
+		sweepWindVelocity = windVelocity;
+	}
+
+	// a chunk row at a time from the bottom
+	int sweepSlices() const {
+		return nyCells;
+	}
+
+	void sweepSlice(int slice) {
+		bool wind = sweepWind;
+		int downwind = sweepWindVelocity > 0.0f ? 1 : -1;
+		int yBottom = (nyCells - slice) * syCellHeight - 1;
+		for (int y = yBottom; y > yBottom - syCellHeight; y--) {
+			int cy = y / syCellHeight;
+			if (!chunks.rowAwake(cy)) continue;
+			uint64_t* occ = occupied[y];
+			uint64_t* dmp = damp[y];
+			// nothing falls out of the bottom row
+			uint64_t* occBelow = y < nyParticles - 1 ? occupied[y + 1] : fullRow;
+			uint64_t* dmpBelow = y < nyParticles - 1 ? damp[y + 1] : scratchRow;
+
+			Row occBefore, dmpBefore, occBelowBefore, dmpBelowBefore;
+			for (int w = 0; w < nWords; w++) {
+				occBefore[w] = occ[w];
+				dmpBefore[w] = dmp[w];
+				occBelowBefore[w] = occBelow[w];
+				dmpBelowBefore[w] = dmpBelow[w];
+			}
+
+			RandomStream random(randomSeed, FirstSweepStream + sweeps * nyParticles + y);
+			resolveRow(occ, dmp, occBelow, dmpBelow, cy, wind, downwind, random);
+
+			Row changed, changedBelow;
+			for (int w = 0; w < nWords; w++) {
+				changed[w] = (occ[w] ^ occBefore[w]) | (dmp[w] ^ dmpBefore[w]);
+				changedBelow[w] = (occBelow[w] ^ occBelowBefore[w]) | (dmpBelow[w] ^ dmpBelowBefore[w]);
+			}
+			wakeChanged(y, changed);
+			recount(y, occBefore, dmpBefore, changed);
+			if (y < nyParticles - 1) {
+				wakeChanged(y + 1, changedBelow);
+				recount(y + 1, occBelowBefore, dmpBelowBefore, changedBelow);
+			}
+		}
+	}
+
+	void finishSweep() {
+		sweeps++;
+		chunks.endSweep();
+	}
+
+private:
+	typedef uint64_t Row[nWords];
+
+	bool sweepWind = false;
+	float sweepWindVelocity = 0.0f;
+	uint64_t randomSeed = 0;
+	uint64_t sweeps = 0;
+
+	uint64_t occupied[nyParticles][nWords];
+	uint64_t damp[nyParticles][nWords];
+	// stands in for the row under the bottom one
+	uint64_t fullRow[nWords];
+	uint64_t scratchRow[nWords];
+	ParticleChunks chunks;
+	CellCounts counts;
+	WetMarks marks;
+
+	// one row's falls, only for particles in awake chunks
+	void resolveRow(uint64_t* occ, uint64_t* dmp, uint64_t* occBelow, uint64_t* dmpBelow, int cy, bool wind, int downwind, RandomStream& random) {
+		Row particle, stuckDamp, ahead, moved;
+		awakeColumns(cy, particle);
+		for (int w = 0; w < nWords; w++) particle[w] &= occ[w] & validMask(w);
+		dampNeighbours(dmp, stuckDamp);
+
+		if (!wind) {
+			// straight down
+			for (int w = 0; w < nWords; w++) moved[w] = particle[w] & ~occBelow[w];
+			move(occ, dmp, occBelow, dmpBelow, moved, 0);
+
+			// damp sand next to damp sand holds its column
+			Row sliders, preferRight, first, second;
+			for (int w = 0; w < nWords; w++) {
+				sliders[w] = particle[w] & ~moved[w] & ~(dmp[w] & stuckDamp[w]);
+				preferRight[w] = random.next();
+			}
+			int firstSide = random.bit() ? 1 : -1;
+			for (int w = 0; w < nWords; w++) {
+				uint64_t prefersFirst = firstSide > 0 ? preferRight[w] : ~preferRight[w];
+				first[w] = sliders[w] & prefersFirst;
+				second[w] = sliders[w] & ~prefersFirst;
+			}
+			slideDown(occ, dmp, occBelow, dmpBelow, first, firstSide);
+			slideDown(occ, dmp, occBelow, dmpBelow, second, -firstSide);
+			slideDown(occ, dmp, occBelow, dmpBelow, first, -firstSide);
+			slideDown(occ, dmp, occBelow, dmpBelow, second, firstSide);
+			return;
+		}
+
+		Row dry, dampSliders, blocked;
+		for (int w = 0; w < nWords; w++) {
+			dry[w] = particle[w] & ~dmp[w];
+			dampSliders[w] = particle[w] & dmp[w] & ~stuckDamp[w];
+		}
+		// dry sand: downwind diagonal, then straight down
+		slideDown(occ, dmp, occBelow, dmpBelow, dry, downwind);
+		for (int w = 0; w < nWords; w++) {
+			moved[w] = (dry[w] | (particle[w] & dmp[w])) & ~occBelow[w];
+			dry[w] &= ~moved[w];
+			dampSliders[w] &= ~moved[w];
+		}
+		move(occ, dmp, occBelow, dmpBelow, moved, 0);
+		// damp sand: downwind diagonal, then upwind diagonal
+		slideDown(occ, dmp, occBelow, dmpBelow, dampSliders, downwind);
+		slideDown(occ, dmp, occBelow, dmpBelow, dampSliders, -downwind);
+		// dry sand that could not drop slides downwind along the row, or else down upwind;
+		// each slider is looked at again where it lands
+		for (int pass = 0; pass < nxParticles; pass++) {
+			pull(occ, ahead, downwind, ~uint64_t(0));
+			bool any = false;
+			for (int w = 0; w < nWords; w++) {
+				moved[w] = dry[w] & ~ahead[w];
+				blocked[w] = dry[w] & ahead[w];
+				any |= moved[w] != 0;
+			}
+			slideDown(occ, dmp, occBelow, dmpBelow, blocked, -downwind);
+			if (!any) break;
+			move(occ, dmp, occ, dmp, moved, downwind);
+			pull(moved, dry, -downwind, 0);
+			slideDown(occ, dmp, occBelow, dmpBelow, dry, downwind);
+			for (int w = 0; w < nWords; w++) {
+				moved[w] = dry[w] & ~occBelow[w];
+				dry[w] &= ~moved[w];
+			}
+			move(occ, dmp, occBelow, dmpBelow, moved, 0);
+		}
+	}
+
+	static uint64_t validMask(int w) {
+		int bits = std::min(64, nxParticles - 64 * w);
+		return bits == 64 ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+	}
+
+	// bits lo to hi - 1 of a word
+	static uint64_t bitsBetween(int lo, int hi) {
+		uint64_t below = hi == 64 ? ~uint64_t(0) : (uint64_t(1) << hi) - 1;
+		return below & ~((uint64_t(1) << lo) - 1);
+	}
+
+	static bool anyBetween(const uint64_t* row, int xLo, int xHi) {
+		for (int w = xLo / 64; w <= (xHi - 1) / 64; w++) {
+			int lo = std::max(xLo - 64 * w, 0);
+			int hi = std::min(xHi - 64 * w, 64);
+			if (row[w] & bitsBetween(lo, hi)) return true;
+		}
+		return false;
+	}
+
+	static int countBetween(const uint64_t* row, int xLo, int xHi) {
+		int n = 0;
+		for (int w = xLo / 64; w <= (xHi - 1) / 64; w++) {
+			int lo = std::max(xLo - 64 * w, 0);
+			int hi = std::min(xHi - 64 * w, 64);
+			n += countBits(row[w] & bitsBetween(lo, hi));
+		}
+		return n;
+	}
+
+	// move row y's share of the cell counts from its old contents to its new ones, and
+	// mark where dry sand has arrived
+	void recount(int y, const uint64_t* occBefore, const uint64_t* dmpBefore, const uint64_t* changed) {
+		Row dryBefore, dryNow;
+		for (int w = 0; w < nWords; w++) {
+			dryBefore[w] = occBefore[w] & ~dmpBefore[w];
+			dryNow[w] = occupied[y][w] & ~damp[y][w];
+		}
+		for (int cx = 0; cx < nxCells; cx++) {
+			int xLo = cx * sxCellWidth;
+			int xHi = xLo + sxCellWidth;
+			if (!anyBetween(changed, xLo, xHi)) continue;
+			counts.add(cx, y / syCellHeight,
+				countBetween(dryNow, xLo, xHi) - countBetween(dryBefore, xLo, xHi),
+				countBetween(damp[y], xLo, xHi) - countBetween(dmpBefore, xLo, xHi));
+		}
+		if (!marks.mayCover(y)) return;
+		for (int w = 0; w < nWords; w++) {
+			uint64_t arrived = dryNow[w] & ~dryBefore[w] & validMask(w);
+			while (arrived) {
+				marks.dryAt(64 * w + lowestBit(arrived), y);
+				arrived &= arrived - 1;
+			}
+		}
+	}
+
+	// columns of the awake chunks in chunk row cy
+	void awakeColumns(int cy, uint64_t* out) const {
+		for (int w = 0; w < nWords; w++) out[w] = 0;
+		for (int cx = 0; cx < nxCells; cx++) {
+			if (!chunks.awake(cx, cy)) continue;
+			for (int w = cx * sxCellWidth / 64; w <= ((cx + 1) * sxCellWidth - 1) / 64; w++) {
+				int lo = std::max(cx * sxCellWidth - 64 * w, 0);
+				int hi = std::min((cx + 1) * sxCellWidth - 64 * w, 64);
+				out[w] |= bitsBetween(lo, hi);
+			}
+		}
+	}
+
+	// wake around the changed particles of row y, chunk by chunk
+	void wakeChanged(int y, const uint64_t* changed) {
+		for (int cx = 0; cx < nxCells; cx++) {
+			int xLeft = cx * sxCellWidth;
+			int xRight = xLeft + sxCellWidth - 1;
+			if (!anyBetween(changed, xLeft, xRight + 1)) continue;
+			// only a change on the chunk's edge column reaches the next chunk across
+			int x1 = anyBetween(changed, xLeft, xLeft + 1) ? xLeft : xLeft + 1;
+			int x2 = anyBetween(changed, xRight, xRight + 1) ? xRight : xRight - 1;
+			chunks.wake(x1, y, x2, y);
+		}
+	}
+
+	// dst bit x = src bit x + dir, with fill past either end
+	static void pull(const uint64_t* src, uint64_t* dst, int dir, uint64_t fill) {
+		if (dir > 0) {
+			for (int w = 0; w < nWords; w++) {
+				uint64_t next = w + 1 < nWords ? src[w + 1] : fill;
+				dst[w] = (src[w] >> 1) | (next << 63);
+			}
+		}
+		else {
+			for (int w = nWords - 1; w >= 0; w--) {
+				uint64_t prev = w > 0 ? src[w - 1] : fill;
+				dst[w] = (src[w] << 1) | (prev >> 63);
+			}
+		}
+	}
+
+	// damp particles with a damp particle either side
+	static void dampNeighbours(const uint64_t* dmp, uint64_t* out) {
+		Row left, right;
+		pull(dmp, left, -1, 0);
+		pull(dmp, right, 1, 0);
+		for (int w = 0; w < nWords; w++) out[w] = left[w] | right[w];
+	}
+
+	// move particles in mask by dir columns from one row to another, or along the same row
+	static void move(uint64_t* occFrom, uint64_t* dmpFrom, uint64_t* occTo, uint64_t* dmpTo, const uint64_t* mask, int dir) {
+		Row dampMask, target, dampTarget;
+		for (int w = 0; w < nWords; w++) dampMask[w] = mask[w] & dmpFrom[w];
+		if (dir == 0) {
+			for (int w = 0; w < nWords; w++) {
+				target[w] = mask[w];
+				dampTarget[w] = dampMask[w];
+			}
+		}
+		else {
+			pull(mask, target, -dir, 0);
+			pull(dampMask, dampTarget, -dir, 0);
+		}
+		for (int w = 0; w < nWords; w++) {
+			occFrom[w] &= ~mask[w];
+			dmpFrom[w] &= ~mask[w];
+			occTo[w] |= target[w];
+			dmpTo[w] |= dampTarget[w];
+		}
+	}
+
+	// move whichever of candidates can fall diagonally towards dir, and drop them from candidates
+	static void slideDown(uint64_t* occ, uint64_t* dmp, uint64_t* occBelow, uint64_t* dmpBelow, uint64_t* candidates, int dir) {
+		Row target, moved;
+		pull(occBelow, target, dir, ~uint64_t(0));
+		for (int w = 0; w < nWords; w++) {
+			moved[w] = candidates[w] & occ[w] & ~target[w];
+			candidates[w] &= ~moved[w];
+		}
+		move(occ, dmp, occBelow, dmpBelow, moved, dir);
+	}
+};
+
+// Margolus engine: each sweep is one pass over 2x2 blocks. The block grid shifts down a
+// particle on alternate sweeps, so a falling particle drops a row per sweep as it does in
+// the scan, and across a particle every other two sweeps, so sand resting at the top of a
+// block gets a turn on both sides of it and piles up evenly both ways. A block's next
+// state depends only on its own four cells and, for damp sand holding onto damp
+// neighbours, on the cells either side of its top row as they were before the pass.
+// Blocks are therefore independent: each one is a single table lookup, and a pass can be
+// split over threads in any way. Outside the grid counts as solid.
+class MargolusParticles : public ParticleCells {
+public:
+	MargolusParticles() {
+		// a block left alone under one offset can still change under another, so a woken
+		// chunk stays awake through a whole cycle of the four
+		chunks.setLinger(4);
+		for (int rules = 0; rules < 3; rules++) {
+			for (int block = 0; block < 1024; block++) {
+				blockRules[rules][block] = settleBlock(block, rules);
+			}
+		}
+	}
+
+	// each thread takes whole chunk rows of blocks; the result is the same either way
+	void setThreads(int threads) {
+		blockThreads = threads;
+		workers.resize(std::max(threads, 1));
+	}
+
+	// the block rules draw nothing
+	void setSeed(uint64_t) {}
+
+	void sweep(bool wind, float windVelocity) {
+		beginSweep(wind, windVelocity);
+		for (int slice = 0; slice < sweepSlices(); slice++) {
+			sweepSlice(slice);
+		}
+		finishSweep();
+	}
+
+	void beginSweep(bool wind, float windVelocity) {
+		chunks.startSweep(wind, windVelocity);
+		passRules = !wind ? CalmRules : windVelocity > 0.0f ? WindRightRules : WindLeftRules;
+		// blocks can't affect each other within a pass, so which to skip is fixed up front
+		for (int cy = 0; cy < nyCells; cy++) {
+			for (int cx = 0; cx < nxCells; cx++) {
+				awake[cy][cx] = chunks.awake(cx, cy);
+			}
+		}
+	}
+
+	// serial passes go a chunk row at a time, threaded ones all at once
+	int sweepSlices() const {
+		return blockThreads == 0 ? nyCells : 1;
+	}
+
+	void sweepSlice(int slice) {
+		int xOffset = int(passes / 2 % 2);
+		int yOffset = int(passes % 2);
+		if (blockThreads == 0) {
+			sweepBlocks(slice, xOffset, yOffset, passRules);
+		}
+		else {
+			workers.run(nyCells, [&](int cy) { sweepBlocks(cy, xOffset, yOffset, passRules); });
+		}
+	}
+
+	void finishSweep() {
+		passes++;
+		chunks.endSweep();
+	}
+
+private:
+	enum { CalmRules, WindRightRules, WindLeftRules };
+	// block cells are two bits each: top left, top right, bottom left, bottom right,
+	// using the Particle values plus Blocked for the border
+
+	// indexed by the four cells, then bit 8 for damp sand left of the block's top row
+	// and bit 9 for damp sand right of it
+	uint8_t blockRules[3][1024];
+	bool awake[nyCells][nxCells];
+	uint64_t passes = 0;
+	int passRules = CalmRules;
+	int blockThreads = 0;
+	SweepWorkers workers;
+
+	// blocks whose top row lies in chunk row cy
+	void sweepBlocks(int cy, int xOffset, int yOffset, int rules) {
+		for (int y = cy * syCellHeight + yOffset; y < (cy + 1) * syCellHeight; y += 2) {
+			int cyBelow = std::min(y + 1, nyParticles - 1) / syCellHeight;
+			bool rowAwake = false;
+			for (int cx = 0; cx < nxCells; cx++) {
+				rowAwake |= awake[cy][cx] || awake[cyBelow][cx];
+			}
+			if (!rowAwake) continue;
+			// damp[x + 1] is column x, with dry margins beyond both edges
+			uint8_t* top = row(y);
+			uint8_t* bottom = row(y + 1);
+			bool damp[nxParticles + 3] = {};
+			for (int x = 0; x < nxParticles; x++) {
+				damp[x + 1] = top[x] == DampSand;
+			}
+			for (int x = xOffset; x < nxParticles; x += 2) {
+				int cxLeft = x / sxCellWidth;
+				int cxRight = std::min(x + 1, nxParticles - 1) / sxCellWidth;
+				if (!awake[cy][cxLeft] && !awake[cy][cxRight] && !awake[cyBelow][cxLeft] && !awake[cyBelow][cxRight]) continue;
+				int block = top[x] | top[x + 1] << 2 | bottom[x] << 4 | bottom[x + 1] << 6
+					| int(damp[x]) << 8 | int(damp[x + 3]) << 9;
+				int settled = blockRules[rules][block];
+				if (settled == (block & 0xFF)) continue;
+				// sand only moves around within a block, so counts change only if it straddles cells
+				bool straddles = x % sxCellWidth == sxCellWidth - 1 || y % syCellHeight == syCellHeight - 1;
+				for (int i = 0; i < 4; i++) {
+					int v = (settled >> (2 * i)) & 3;
+					if (v == Blocked) continue;
+					uint8_t& p = row(y + i / 2)[x + i % 2];
+					if (straddles) counts.change(x + i % 2, y + i / 2, Particle(p), Particle(v));
+					if (v == DrySand && p != DrySand && marks.mayCover(y + i / 2)) marks.dryAt(x + i % 2, y + i / 2);
+					p = uint8_t(v);
+				}
+				chunks.wake(x, y, x + 1, y + 1);
+			}
+		}
+	}
+
+	// the same fall rules as the scan engine, applied within one block
+	static uint8_t settleBlock(int block, int rules) {
+		int c[4];
+		for (int i = 0; i < 4; i++) c[i] = (block >> (2 * i)) & 3;
+		bool leftDamp = (block >> 8) & 1;
+		bool rightDamp = (block >> 9) & 1;
+		// wind to the left is wind to the right in a mirror
+		if (rules == WindLeftRules) {
+			std::swap(c[0], c[1]);
+			std::swap(c[2], c[3]);
+			std::swap(leftDamp, rightDamp);
+		}
+		auto movable = [&](int i) { return c[i] == DrySand || c[i] == DampSand; };
+		auto move = [&](int from, int to) {
+			c[to] = c[from];
+			c[from] = NoParticle;
+		};
+		// damp sand next to damp sand holds its column
+		bool heldLeft = c[0] == DampSand && (c[1] == DampSand || leftDamp);
+		bool heldRight = c[1] == DampSand && (c[0] == DampSand || rightDamp);
+		if (rules == CalmRules) {
+			if (movable(0) && c[2] == NoParticle) move(0, 2);
+			if (movable(1) && c[3] == NoParticle) move(1, 3);
+			if (movable(0) && !heldLeft && c[3] == NoParticle) move(0, 3);
+			if (movable(1) && !heldRight && c[2] == NoParticle) move(1, 2);
+		}
+		else {
+			// downwind is right: dry sand takes the downwind diagonal, then straight down,
+			// then slides along; the right-hand particle's downwind moves leave the block
+			if (c[0] == DrySand) {
+				if (c[3] == NoParticle) move(0, 3);
+				else if (c[2] == NoParticle) move(0, 2);
+				else if (c[1] == NoParticle) move(0, 1);
+			}
+			else if (c[0] == DampSand) {
+				if (c[2] == NoParticle) move(0, 2);
+				else if (!heldLeft && c[3] == NoParticle) move(0, 3);
+			}
+			if (movable(1)) {
+				if (c[3] == NoParticle) move(1, 3);
+				else if (!heldRight && c[2] == NoParticle) move(1, 2);
+			}
+		}
+		if (rules == WindLeftRules) {
+			std::swap(c[0], c[1]);
+			std::swap(c[2], c[3]);
+		}
+		return uint8_t(c[0] | c[1] << 2 | c[2] << 4 | c[3] << 6);
+	}
+};
+
+#if defined(BEACH_PARTICLES_BITPLANE)
+typedef BitPlaneParticles ParticleGrid;
+#elif defined(BEACH_PARTICLES_MARGOLUS)
+typedef MargolusParticles ParticleGrid;
+#else
+typedef ScanParticles ParticleGrid;
+#endif
+
+enum BucketState {
+	BucketEmpty,
+	BucketSand,
+	BucketWater,
+	BucketDampSand,
+	BucketWood
+};
+
+enum GameState {
+	Normal,
+	Drowning,
+	Menu,
+	Won
+};
+
+// A set of castle cells, one bit each, numbered column by column from the top left, so
+// membership changes are constant time and walking the set visits only its members.
+class CellSet {
+public:
+	static const int nWords = (nxCells * nyCells + 63) / 64;
+
+	// every cell in the top rows
+	static CellSet rowsAbove(int cyEnd) {
+		CellSet s;
+		for (int cx = 0; cx < nxCells; cx++) {
+			for (int cy = 0; cy < cyEnd; cy++) s.insert(cx, cy);
+		}
+		return s;
+	}
+
+	void clear() {
+		for (int w = 0; w < nWords; w++) bits[w] = 0;
+	}
+
+	void insert(int cx, int cy) {
+		int i = index(cx, cy);
+		bits[i / 64] |= uint64_t(1) << (i % 64);
+	}
+
+	void erase(int cx, int cy) {
+		int i = index(cx, cy);
+		bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+	}
+
+	bool contains(int cx, int cy) const {
+		int i = index(cx, cy);
+		return (bits[i / 64] >> (i % 64)) & 1;
+	}
+
+	bool empty() const {
+		for (int w = 0; w < nWords; w++) {
+			if (bits[w]) return false;
+		}
+		return true;
+	}
+
+	int size() const {
+		int n = 0;
+		for (int w = 0; w < nWords; w++) n += countBits(bits[w]);
+		return n;
+	}
+
+	CellSet operator&(const CellSet& other) const {
+		CellSet s;
+		for (int w = 0; w < nWords; w++) s.bits[w] = bits[w] & other.bits[w];
+		return s;
+	}
+
+	// first member numbered i or later, or -1; a member's cell is (i / nyCells, i % nyCells)
+	int next(int i) const {
+		for (int w = i / 64; w < nWords && i < nxCells * nyCells; w++) {
+			uint64_t left = w == i / 64 ? bits[w] >> (i % 64) << (i % 64) : bits[w];
+			if (left) return 64 * w + lowestBit(left);
+		}
+		return -1;
+	}
+
+private:
+	uint64_t bits[nWords] = {};
+
+	static int index(int cx, int cy) {
+		return cx * nyCells + cy;
+	}
+};
+
+// The surfaces things can stand on: per column, bit cy for each full damp cell, so
+// finding the floor under something is a mask and a bit scan.
+class CastleFloors {
+public:
+	void set(int cx, int cy, bool floor) {
+		if (floor) {
+			columns[cx] |= uint16_t(1 << cy);
+		}
+		else {
+			columns[cx] &= uint16_t(~(1 << cy));
+		}
+	}
+
+	uint16_t column(int cx) const {
+		return columns[cx];
+	}
+
+	// The first floor at or below pixel row sy over column cx, as the pixel row things
+	// stand on: just above a full damp cell, or the beach. Off the castle there's only
+	// the beach, and below the beach there's nothing (max int).
+	int syFloorFrom(int cx, int sy) const {
+		int cyFirst = std::min(std::max(sy + syCellHeight, 0) / syCellHeight, nyCells + 1);
+		uint32_t below = cx >= 0 && cx < nxCells ? columns[cx] : 0;
+		below = (below | 1u << nyCells) >> cyFirst << cyFirst;
+		if (below == 0) return std::numeric_limits<int>::max();
+		return lowestBit(below) * syCellHeight - 1;
+	}
+
+	// whether something over columns cxLeft to cxRight with its bottom at pixel row sy is
+	// standing on a floor
+	bool onFloor(int cxLeft, int cxRight, int sy) const {
+		return syFloorFrom(cxLeft, sy) == sy || syFloorFrom(cxRight, sy) == sy;
+	}
+
+	// Drops y by up to distance onto the first floor under columns cxLeft to cxRight, where
+	// syBottomOf(y) is the bottom row. Lands and moves exactly as stepping down a pixel at a
+	// time and checking the floor each step would; returns the last bottom row checked.
+	template <typename BottomRow>
+	int fall(float& y, float distance, int cxLeft, int cxRight, BottomRow syBottomOf) const {
+		auto syBottomAfter = [&](int k) { return syBottomOf(addPixels(y, k)); };
+		int sy = syBottomOf(y);
+		if (distance <= 0.0f) return sy;
+		int steps = int(std::ceil(distance));
+		// rounding can carry the bottom row a row further on some step, so find the first
+		// step reaching each floor in turn rather than assuming a row per step
+		int k = 0;
+		while (true) {
+			int syFloor = std::min(syFloorFrom(cxLeft, sy), syFloorFrom(cxRight, sy));
+			if (syFloor == sy) {
+				y = addPixels(y, k);
+				return sy;
+			}
+			if (syFloor >= syBeachMax) break;
+			int kFloor = std::min(k + (syFloor - sy), steps);
+			while (kFloor > k + 1 && syBottomAfter(kFloor - 1) >= syFloor) kFloor--;
+			while (kFloor < steps && syBottomAfter(kFloor) < syFloor) kFloor++;
+			if (kFloor >= steps) break;
+			k = kFloor;
+			sy = syBottomAfter(k);
+		}
+		int syLast = syBottomAfter(steps - 1);
+		y = addPixels(y, steps - 1) + (distance - float(steps - 1));
+		return syLast;
+	}
+
+	// y + 1 + 1 ... n times, rounded the same. Adding 1 is exact until y crosses a power of
+	// two, so jump to each crossing and only step across it.
+	static float addPixels(float y, int n) {
+		while (n > 0) {
+			if (y >= 1.0f) {
+				float syNextPower = std::exp2(float(std::ilogb(y) + 1));
+				int exact = std::min(n, int(std::ceil(syNextPower - y)) - 1);
+				y += float(exact);
+				n -= exact;
+			}
+			if (n > 0) {
+				y += 1.0f;
+				n--;
+			}
+		}
+		return y;
+	}
+
+private:
+	uint16_t columns[nxCells] = {};
+};
+
+// Ladders lying loose, kept in three runs: floating on the sea, falling, then resting on
+// a floor. A step only works on the first two; resting ones wake when a floor under them
+// goes or the tide reaches them. Each ladder is also bucketed by its left cell column so
+// finding ones by the player looks at a few columns, and removal swaps with the last.
+class LooseLadders {
+public:
+	void clear() {
+		ladders.clear();
+		for (auto& bucket : buckets) bucket.clear();
+		nFloating = 0;
+		nActive = 0;
+		syRestingMax = std::numeric_limits<float>::lowest();
+		for (int cx = 0; cx < nxCells; cx++) floorsSeen[cx] = 0;
+	}
+
+	int size() const {
+		return int(ladders.size());
+	}
+
+	// where to draw ladder n, alpha of the way from where the last step found it
+	olc::vf2d drawnAt(int n, float alpha) const {
+		const Ladder& l = ladders[n];
+		if (l.movedStep != step) return l.pos;
+		return l.lastPos + (l.pos - l.lastPos) * alpha;
+	}
+
+	// moves from here on are drawn from where ladders are now
+	void beginStep() {
+		step++;
+	}
+
+	void add(olc::vf2d pos) {
+		ladders.push_back(Ladder{ pos, pos, step - 1, Falling, 0, 0 });
+		bucket(size() - 1, bucketOf(pos.x));
+		wake(size() - 1);
+	}
+
+	void remove(int n) {
+		if (n < nFloating) {
+			swap(n, --nFloating);
+			n = nFloating;
+		}
+		if (n < nActive) {
+			swap(n, --nActive);
+			n = nActive;
+		}
+		swap(n, size() - 1);
+		unbucket(size() - 1);
+		ladders.pop_back();
+	}
+
+	// a ladder overlapping the box from sxLeft to sxRight and syTop to syBottom, or -1
+	int touching(float sxLeft, float sxRight, float syTop, float syBottom) const {
+		for (int b = bucketOf(sxLeft - sxCellWidth); b <= bucketOf(sxRight + 1); b++) {
+			for (int n : buckets[b]) {
+				olc::vi2d pos = ladders[n].pos;
+				if (
+					pos.x <= sxRight
+					&& pos.x + sxCellsOffset - 1 >= sxLeft
+					&& syBottom >= pos.y - syCrenelHeight
+					&& syTop <= pos.y + syCellHeight/4 - 1
+				) {
+					return n;
+				}
+			}
+		}
+		return -1;
+	}
+
+	// Wakes resting ladders that lost their floor or that the tide reached, then awake ones
+	// fall fallDistance (unless held) and float up to the sea, and settle into their runs.
+	void update(const CastleFloors& floors, int sySeaLevel, float fallDistance, bool held) {
+		for (int cx = 0; cx < nxCells; cx++) {
+			if (floorsSeen[cx] & ~floors.column(cx)) {
+				wakeBucket(bucketOf(cx) - 1);
+				wakeBucket(bucketOf(cx));
+			}
+			floorsSeen[cx] = floors.column(cx);
+		}
+
+		// the tide floats ladders it reaches
+		float syAfloat = float(sySeaLevel - syCellHeight/4);
+		if (syRestingMax + syCellHeight/4 >= sySeaLevel) {
+			syRestingMax = std::numeric_limits<float>::lowest();
+			for (int n = nActive; n < size(); n++) {
+				if (ladders[n].pos.y + syCellHeight/4 >= sySeaLevel) {
+					wake(n);
+				}
+				else {
+					syRestingMax = std::max(syRestingMax, ladders[n].pos.y);
+				}
+			}
+		}
+
+		for (int n = 0; n < nActive; n++) {
+			Ladder& l = ladders[n];
+			int cxLeft = floor((l.pos.x - sxCellsOffset) / sxCellWidth);
+			int cxRight = floor((l.pos.x + sxCellWidth - 1 - sxCellsOffset) / sxCellWidth);
+			olc::vf2d pos = l.pos;
+			if (!held) {
+				floors.fall(pos.y, fallDistance, cxLeft, cxRight, [](float y) { return int(y + syCellHeight/4 - 1); });
+			}
+			if (pos.y + syCellHeight/4 > sySeaLevel) {
+				pos.y = syAfloat;
+			}
+			moveTo(l, pos);
+			if (pos.y == syAfloat) l.state = Floating;
+			else if (floors.onFloor(cxLeft, cxRight, int(pos.y + syCellHeight/4 - 1))) l.state = Resting;
+			else l.state = Falling;
+		}
+
+		// three-way partition of the awake run
+		int nEnd = nActive;
+		int n = 0;
+		nFloating = 0;
+		while (n < nActive) {
+			switch (ladders[n].state) {
+			case Floating:
+				swap(nFloating++, n++);
+				break;
+			case Falling:
+				n++;
+				break;
+			case Resting:
+				swap(n, --nActive);
+				break;
+			}
+		}
+		for (n = nActive; n < nEnd; n++) {
+			syRestingMax = std::max(syRestingMax, ladders[n].pos.y);
+		}
+	}
+
+	// wind pushes floating ladders a pixel, keeping them over the beach
+	void push(float windVelocity) {
+		for (int n = 0; n < nFloating; n++) {
+			olc::vf2d pos = ladders[n].pos;
+			if (windVelocity > 0.0f && pos.x + sxCellsOffset - 1 < sxScreenWidth - 1) {
+				pos.x += 1;
+			}
+			else {
+				if (windVelocity < 0.0f && pos.x > sxCellsOffset) {
+					pos.x -= 1;
+				}
+			}
+			moveTo(ladders[n], pos);
+			if (bucketOf(pos.x) != ladders[n].bucket) {
+				unbucket(n);
+				bucket(n, bucketOf(pos.x));
+			}
+		}
+	}
+
+private:
+	enum LadderState {
+		Floating,
+		Falling,
+		Resting
+	};
+
+	struct Ladder {
+		olc::vf2d pos;
+		olc::vf2d lastPos;
+		int movedStep;
+		LadderState state;
+		int bucket;
+		int slot;
+	};
+
+	// dropped ladders can hang a column off the left edge
+	static const int cxFirstBucket = -2;
+	static const int nBuckets = nxCells + 3;
+
+	std::vector<Ladder> ladders;
+	std::vector<int> buckets[nBuckets];
+	int nFloating = 0;
+	int nActive = 0;
+	// lowest any resting ladder could be, to know when the tide might reach one
+	float syRestingMax = std::numeric_limits<float>::lowest();
+	uint16_t floorsSeen[nxCells] = {};
+	int step = 0;
+
+	static int bucketOf(float sx) {
+		return bucketOf(int(floor((sx - sxCellsOffset) / sxCellWidth)));
+	}
+
+	static int bucketOf(int cx) {
+		return std::min(std::max(cx - cxFirstBucket, 0), nBuckets - 1);
+	}
+
+	void moveTo(Ladder& l, olc::vf2d pos) {
+		if (pos == l.pos) return;
+		if (l.movedStep != step) {
+			l.lastPos = l.pos;
+			l.movedStep = step;
+		}
+		l.pos = pos;
+	}
+
+	// resting ladder n joins the falling run
+	void wake(int n) {
+		swap(n, nActive++);
+	}
+
+	void wakeBucket(int b) {
+		for (int n : buckets[b]) {
+			if (n >= nActive) wake(n);
+		}
+	}
+
+	void swap(int n, int m) {
+		if (n == m) return;
+		std::swap(ladders[n], ladders[m]);
+		buckets[ladders[n].bucket][ladders[n].slot] = n;
+		buckets[ladders[m].bucket][ladders[m].slot] = m;
+	}
+
+	void bucket(int n, int b) {
+		ladders[n].bucket = b;
+		ladders[n].slot = int(buckets[b].size());
+		buckets[b].push_back(n);
+	}
+
+	void unbucket(int n) {
+		std::vector<int>& b = buckets[ladders[n].bucket];
+		int last = b.back();
+		b[ladders[n].slot] = last;
+		ladders[last].slot = ladders[n].slot;
+		b.pop_back();
+	}
+};
+
+// Raindrops in world units, positions in separate arrays sized once up front. A storm
+// past capacity just doesn't spawn more. Each step moves and culls every drop in one
+// pass, eight or four drops at a time where the CPU allows, keeping survivors in order.
+class Raindrops {
+public:
+	void setCapacity(int capacity) {
+		wxs.assign(capacity, 0.0f);
+		wys.assign(capacity, 0.0f);
+		count = 0;
+	}
+
+	void clear() {
+		count = 0;
+	}
+
+	int size() const {
+		return count;
+	}
+
+	float x(int n) const {
+		return wxs[n];
+	}
+
+	float y(int n) const {
+		return wys[n];
+	}
+
+	void add(float wx, float wy) {
+		if (count == int(wxs.size())) return;
+		wxs[count] = wx;
+		wys[count] = wy;
+		count++;
+	}
+
+	// moves every drop by wdx, wdy; then drops below wyMax or outside wxMin to wxMax are gone
+	void step(float wdx, float wdy, float wyMax, float wxMin, float wxMax) {
+		// survivors are written back at kept, never past n, so reads stay ahead of writes
+		int n = 0;
+		int kept = 0;
+#if defined(BEACH_AVX2_DISPATCH)
+		static const bool avx2 = __builtin_cpu_supports("avx2");
+		if (avx2) stepAvx2(n, kept, wdx, wdy, wyMax, wxMin, wxMax);
+#endif
+#if defined(__SSE2__)
+		stepSse2(n, kept, wdx, wdy, wyMax, wxMin, wxMax);
+#endif
+		for (; n < count; n++) {
+			float wx = wxs[n] + wdx;
+			float wy = wys[n] + wdy;
+			if (!(wy > wyMax || wx < wxMin || wx > wxMax)) keep(kept, wx, wy);
+		}
+		count = kept;
+	}
+
+private:
+	std::vector<float> wxs;
+	std::vector<float> wys;
+	int count = 0;
+
+	void keep(int& kept, float wx, float wy) {
+		wxs[kept] = wx;
+		wys[kept] = wy;
+		kept++;
+	}
+
+	// the survivors of a block of moved drops, one per mask bit
+	void keepBlock(int& kept, const float* wx, const float* wy, unsigned mask) {
+		for (; mask; mask &= mask - 1) {
+			int i = lowestBit(mask);
+			keep(kept, wx[i], wy[i]);
+		}
+	}
+
+#if defined(__SSE2__)
+	void stepSse2(int& n, int& kept, float wdx, float wdy, float wyMax, float wxMin, float wxMax) {
+		const __m128 dx = _mm_set1_ps(wdx);
+		const __m128 dy = _mm_set1_ps(wdy);
+		const __m128 yMax = _mm_set1_ps(wyMax);
+		const __m128 xMin = _mm_set1_ps(wxMin);
+		const __m128 xMax = _mm_set1_ps(wxMax);
+		for (; n + 4 <= count; n += 4) {
+			__m128 x = _mm_add_ps(_mm_loadu_ps(&wxs[n]), dx);
+			__m128 y = _mm_add_ps(_mm_loadu_ps(&wys[n]), dy);
+			__m128 dead = _mm_or_ps(_mm_cmpgt_ps(y, yMax), _mm_or_ps(_mm_cmplt_ps(x, xMin), _mm_cmpgt_ps(x, xMax)));
+			unsigned mask = ~unsigned(_mm_movemask_ps(dead)) & 0xf;
+			if (kept == n && mask == 0xf) {
+				_mm_storeu_ps(&wxs[n], x);
+				_mm_storeu_ps(&wys[n], y);
+				kept += 4;
+				continue;
+			}
+			float wx[4], wy[4];
+			_mm_storeu_ps(wx, x);
+			_mm_storeu_ps(wy, y);
+			keepBlock(kept, wx, wy, mask);
+		}
+	}
+#endif
+
+#if defined(BEACH_AVX2_DISPATCH)
+	__attribute__((target("avx2")))
+	void stepAvx2(int& n, int& kept, float wdx, float wdy, float wyMax, float wxMin, float wxMax) {
+		const __m256 dx = _mm256_set1_ps(wdx);
+		const __m256 dy = _mm256_set1_ps(wdy);
+		const __m256 yMax = _mm256_set1_ps(wyMax);
+		const __m256 xMin = _mm256_set1_ps(wxMin);
+		const __m256 xMax = _mm256_set1_ps(wxMax);
+		for (; n + 8 <= count; n += 8) {
+			__m256 x = _mm256_add_ps(_mm256_loadu_ps(&wxs[n]), dx);
+			__m256 y = _mm256_add_ps(_mm256_loadu_ps(&wys[n]), dy);
+			__m256 dead = _mm256_or_ps(_mm256_cmp_ps(y, yMax, _CMP_GT_OQ),
+				_mm256_or_ps(_mm256_cmp_ps(x, xMin, _CMP_LT_OQ), _mm256_cmp_ps(x, xMax, _CMP_GT_OQ)));
+			unsigned mask = ~unsigned(_mm256_movemask_ps(dead)) & 0xff;
+			if (kept == n && mask == 0xff) {
+				_mm256_storeu_ps(&wxs[n], x);
+				_mm256_storeu_ps(&wys[n], y);
+				kept += 8;
+				continue;
+			}
+			float wx[8], wy[8];
+			_mm256_storeu_ps(wx, x);
+			_mm256_storeu_ps(wy, y);
+			keepBlock(kept, wx, wy, mask);
+		}
+	}
+#endif
+};
+
+enum WorldEvent {
+	SunburnEvent,
+	RainEvent,
+	WindEvent,
+	WindStopEvent,
+	WoodPushEvent,
+	TideEvent,
+	TideMessageEndEvent,
+	BurnOutEvent
+};
+
+// Events waiting for a time, soonest first (a binary min-heap), ties in the order they
+// were scheduled. Nothing is polled: a timer costs only its push and pop.
+class EventQueue {
+public:
+	struct Event {
+		double time;
+		uint64_t order;
+		WorldEvent kind;
+		int arg;
+	};
+
+	void clear() {
+		heap.clear();
+	}
+
+	void schedule(double time, WorldEvent kind, int arg = 0) {
+		heap.push_back(Event{ time, scheduled++, kind, arg });
+		std::push_heap(heap.begin(), heap.end(), later);
+	}
+
+	// takes the soonest event if it's due by now
+	bool pop(double now, Event& e) {
+		if (heap.empty() || heap.front().time > now) return false;
+		std::pop_heap(heap.begin(), heap.end(), later);
+		e = heap.back();
+		heap.pop_back();
+		return true;
+	}
+
+private:
+	std::vector<Event> heap;
+	uint64_t scheduled = 0;
+
+	static bool later(const Event& a, const Event& b) {
+		return a.time > b.time || (a.time == b.time && a.order > b.order);
+	}
+};
+
+// A small picture drawn once into a sprite, then copied into the draw target a run of
+// pixels at a time. Only the runs the picture drew are copied, so its clear pixels
+// leave what's behind, and the cost is fixed by its shape rather than by how it was drawn.
+class Stamp {
+public:
+	Stamp() {}
+
+	explicit Stamp(const olc::Sprite& picture) {
+		for (int y = 0; y < picture.height; y++) {
+			int x = 0;
+			while (x < picture.width) {
+				if (picture.GetPixel(x, y).a == 0) {
+					x++;
+					continue;
+				}
+				Run run = { y, x, 0, int(pixels.size()) };
+				for (; x < picture.width && picture.GetPixel(x, y).a != 0; x++) {
+					pixels.push_back(picture.GetPixel(x, y));
+					run.n++;
+				}
+				runs.push_back(run);
+			}
+		}
+	}
+
+	// top left of the picture at (sx, sy), clipped to the target
+	void draw(olc::Sprite* target, int sx, int sy) const {
+		for (const Run& run : runs) {
+			int y = sy + run.y;
+			if (y < 0 || y >= target->height) continue;
+			int x1 = std::max(sx + run.x, 0);
+			int x2 = std::min(sx + run.x + run.n, int(target->width));
+			if (x1 >= x2) continue;
+			std::memcpy(target->GetData() + y * target->width + x1, &pixels[run.first + x1 - sx - run.x], (x2 - x1) * sizeof(olc::Pixel));
+		}
+	}
+
+private:
+	struct Run {
+		int y, x, n;
+		int first; // into pixels
+	};
+	std::vector<Run> runs;
+	std::vector<olc::Pixel> pixels;
+};
+
+class Game : public olc::PixelGameEngine
+{
+public:
+	Game()
+	{
+		sAppName = "Beach Weather";
+		raindrops.setCapacity(rainCapacity);
+	}
+
+private:
+
+	float sxPlayerX = 60.0f;
+	float syPlayerY = float(syBeachMax - 1);
+
+	bool raining = false;
+	float rainCharge = 0.0f;
+	Raindrops raindrops;
+
+	bool wind;
+	float windVelocity;
+
+	bool seaRising;
+	float wySeaLevel;
+
+	ActionState actionState = Idle;
+
+	ParticleGrid particles;
+	CastleCell castleGrid[nyCells][nxCells];
+	CastleFloors floors;
+
+	// layers front to back: layer 0 is cleared and redrawn every frame, the particle
+	// layer keeps its pixels and is redrawn only where rows changed, and the scenery
+	// behind is baked once per sun colour
+	uint8_t particleLayer = 0;
+	uint8_t sceneryLayer = 0;
+	olc::Pixel sceneryBakedSun = olc::BLANK;
+
+	// cells with a ladder set in them; drawing walks the set
+	CellSet ladderCells;
+	LooseLadders looseLadders;
+	bool nearUpLadder;
+	bool nearDownLadder;
+
+	// full damp cells, which the sun can burn if above the sea
+	CellSet dampCells;
+	CellSet burningCells;
+	double burnEnds[nyCells][nxCells];
+
+	int cxPlayerX;
+	int cyPlayerY;
+
+	void drawCrenel(int sx, int sy) {
+		crenelStamp.draw(GetDrawTarget(), sx, sy - syCrenelHeight);
+	}
+
+	// a ladder in the cell whose top left is (sx, sy), without its left and right margins
+	void drawLadder(int sx, int sy) {
+		ladderStamp.draw(GetDrawTarget(), sx + sxLadderOffset, sy + 1);
+	}
+
+	// crenels and ladders are drawn once into stamps, then copied
+	Stamp crenelStamp;
+	Stamp ladderStamp;
+
+	void makeStamps() {
+		olc::Sprite crenel(sxCrenelWidth, syCrenelHeight + 1);
+		SetDrawTarget(&crenel);
+		Clear(olc::BLANK);
+		paintCrenel(0, syCrenelHeight);
+		crenelStamp = Stamp(crenel);
+
+		olc::Sprite ladder(sxCellWidth - 2 * sxLadderOffset, syCellHeight - 1);
+		SetDrawTarget(&ladder);
+		Clear(olc::BLANK);
+		paintLadder(-sxLadderOffset, -1);
+		ladderStamp = Stamp(ladder);
+		SetDrawTarget(nullptr);
+	}
+
+	void paintCrenel(int sx, int sy) {
+		// fill one extra line dark yellow height to overwrite "lid" of the block
+		FillRect(sx + 1, sy - syCrenelHeight, sxCrenelWidth - 2, syCrenelHeight + 1, olc::DARK_YELLOW);
+		DrawLine(sx, sy - syCrenelHeight, sx, sy - 1, olc::VERY_DARK_YELLOW);
+		DrawLine(sx + sxCrenelWidth - 1, sy - syCrenelHeight, sx + sxCrenelWidth - 1, sy - 1, olc::VERY_DARK_YELLOW);
+		DrawLine(sx, sy - syCrenelHeight, sx + sxCrenelWidth - 1, sy - syCrenelHeight, olc::VERY_DARK_YELLOW);
+	}
+
+	// (sx, sy) is the top left of the cell
+	void paintLadder(int sx, int sy) {
+		int sxLeft = sx + sxLadderOffset;
+		int sxRight = sx + sxCellWidth - sxLadderOffset - 1;
+		DrawLine(sxLeft, sy + 1, sxLeft, sy + syCellHeight - 1, brown);
+		DrawLine(sxRight, sy + 1, sxRight, sy + syCellHeight - 1, brown);
+		for (int rung = 1; rung <= 3; rung++) {
+			DrawLine(sxLeft, sy + rung * syCrenelHeight, sxRight, sy + rung * syCrenelHeight, brown);
+		}
+	}
+
+	bool hasLadder(int cx, int cy) const {
+		return cx >= 0 && cx < nxCells && cy >= 0 && cy < nyCells && ladderCells.contains(cx, cy);
+	}
+
+	void setCell(int cx, int cy, CastleCell cell) {
+		castleGrid[cy][cx] = cell;
+		floors.set(cx, cy, cell == FullDampCell);
+		if (cell == FullDampCell) {
+			dampCells.insert(cx, cy);
+		}
+		else {
+			dampCells.erase(cx, cy);
+		}
+	}
+
+	BucketState bucket;
+
+	RandomStream sunburnRandom;
+	RandomStream windRandom;
+	RandomStream rainRandom;
+
+	// Weather runs on world time and burns on play time, which stops once the castle is
+	// won. Anything that happens at a time rather than at a rate waits in a queue.
+	double worldTime;
+	double playTime;
+	EventQueue weatherEvents;
+	EventQueue burnEvents;
+	// bumped when the wind stops, so its pending pushes lapse
+	int windGeneration = 0;
+
+	float particleMoveCharge;
+
+	bool displayingTideEvent;
+
+	GameState gameState = Menu;
+
+	void resetGameVariables(bool menu = false) {
+		sxPlayerX = 60.0f;
+		syPlayerY = float(syBeachMax - 1);
+
+		raining = false;
+		rainCharge = 0.0f;
+
+		raindrops.clear();
+
+		wind = false;
+		windVelocity = windSpeed;
+
+		seaRising = false;
+		wySeaLevel = wySeaStart;
+		displayingTideEvent = false;
+
+		actionState = Idle;
+
+		particles.clear();
+		for (int y = 0; y < nyCells; y++) {
+			for (int x = 0; x < nxCells; x++) {
+				setCell(x, y, NonFullCell);
+			}
+		}
+		if (menu) {
+			for (int cx = nxCells / 2; cx < nxCells / 2 + 3; cx++) {
+				setCell(cx, nyCells - 1, FullDampCell);
+				for (int x = cx*sxCellWidth; x < (cx + 1) * sxCellWidth; x++) {
+					for (int y = (nyCells - 1) * syCellHeight; y < nyCells * syCellHeight; y++) {
+						particles.set(x, y, DampSand);
+					}
+				}
+			}
+			setCell(nxCells / 2 + 1, nyCells - 2, FullDampCell);
+			for (int x = (nxCells/2 + 1) * sxCellWidth; x < (nxCells/2 + 2) * sxCellWidth; x++) {
+				for (int y = (nyCells - 2) * syCellHeight; y < (nyCells - 1) * syCellHeight; y++) {
+					particles.set(x, y, DampSand);
+				}
+			}
+		}
+
+		ladderCells.clear();
+		looseLadders.clear();
+		nearUpLadder = false;
+		nearDownLadder = false;
+
+		burningCells.clear();
+
+		worldTime = 0.0;
+		playTime = 0.0;
+		weatherEvents.clear();
+		burnEvents.clear();
+		windGeneration++;
+		weatherEvents.schedule(1.0 / sunburnEventRate, SunburnEvent);
+		weatherEvents.schedule(timeToRain, RainEvent);
+		weatherEvents.schedule(timeToTide, TideEvent);
+
+		bucket = BucketEmpty;
+
+		particleMoveCharge = 0.0f;
+		sweepCursor = -1;
+
+		rememberPositions();
+	}
+
+	const int sxBucketWidth = 3 * sxCrenelOffset + sxCrenelWidth;
+	const int syBucketHeight = syScreenHeight - syBeachMax - 1;
+
+	// Everything the HUD shows: keys, bucket, messages. It's drawn into its own sprite,
+	// redrawn and uploaded only when this changes, and laid over the frame as a decal.
+	// (Layer 0 is always the front layer and uploaded every frame, so a decal on it is
+	// the way to keep a cached picture in front of it.)
+	struct HudState {
+		GameState gameState;
+		BucketState bucket;
+		bool canGetSand, canGetWater, canGetWood, canDump;
+		bool tideMessage;
+		int lag;
+
+		bool operator==(const HudState& o) const {
+			return gameState == o.gameState && bucket == o.bucket
+				&& canGetSand == o.canGetSand && canGetWater == o.canGetWater
+				&& canGetWood == o.canGetWood && canDump == o.canDump
+				&& tideMessage == o.tideMessage && lag == o.lag;
+		}
+	};
+	olc::Renderable hudPicture;
+	HudState hudShown;
+	bool hudDrawn = false;
+
+	void drawHud() {
+		HudState hud = { gameState, bucket, canGetSand, canGetWater, canGetWood, canDump, displayingTideEvent, int(sweepLag()) };
+		if (!hudDrawn || !(hud == hudShown)) {
+			SetDrawTarget(hudPicture.Sprite());
+			Clear(olc::BLANK);
+			paintHud(hud);
+			SetDrawTarget(nullptr);
+			hudPicture.Decal()->Update();
+			hudShown = hud;
+			hudDrawn = true;
+		}
+		DrawDecal({ 0.0f, 0.0f }, hudPicture.Decal());
+	}
+
+	void paintHud(const HudState& hud) {
+		if (hud.gameState == Menu) {
+			writeCentred(sxScreenWidth/2, syScreenHeight/2 - letterSize*3, "Beach Weather");
+			writeCentred(sxScreenWidth/2, syScreenHeight/2, "F to start");
+			return;
+		}
+
+		// draw controls UI
+		switch (hud.bucket) {
+		case BucketEmpty:
+			FillKey(0, syScreenHeight - syKeyHeight - 1, olc::BLUE, "A", hud.canGetWater);
+			FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - syKeyHeight - 1, olc::YELLOW, "S", hud.canGetSand);
+			break;
+		case BucketSand:
+			FillKey(0, syScreenHeight - syKeyHeight - 1, olc::DARK_YELLOW, "A", hud.canGetWater);
+			FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - syKeyHeight - 1, olc::YELLOW, "S", hud.canGetSand);
+			break;
+		case BucketDampSand:
+			FillKey(0, syScreenHeight - syKeyHeight - 1, olc::BLUE, "A", hud.canGetWater);
+			FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - syKeyHeight - 1, olc::YELLOW, "S", hud.canGetSand);
+			break;
+		case BucketWater:
+			FillKey(0, syScreenHeight - syKeyHeight - 1, olc::BLUE, "A", hud.canGetWater);
+			FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - syKeyHeight - 1, olc::DARK_YELLOW, "S", hud.canGetSand);
+			break;
+		case BucketWood:
+			FillKey(0, syScreenHeight - syKeyHeight - 1, olc::BLUE, "A", hud.canGetWater);
+			FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - syKeyHeight - 1, olc::YELLOW, "S", hud.canGetSand);
+			break;
+		}
+		FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - 2 * syKeyHeight - sKeySpacing - 1, brown, "W", hud.canGetWood);
+		FillKey(2 * (sxKeyWidth + sKeySpacing), syScreenHeight - syKeyHeight - 1, olc::CYAN, "D", hud.canDump);
+
+		// draw bucket UI
+		FillRect(sxScreenWidth - sxBucketWidth, syBeachMax + 1, sxBucketWidth, syBucketHeight, olc::GREY);
+		switch(hud.bucket) {
+		case BucketEmpty:
+			FillBucket(olc::CYAN);
+			break;
+		case BucketSand:
+			FillBucket(olc::YELLOW);
+			break;
+		case BucketWater:
+			FillBucket(olc::DARK_BLUE);
+			break;
+		case BucketDampSand:
+			FillBucket(olc::DARK_YELLOW);
+			break;
+		case BucketWood:
+			FillBucket(brown);
+			break;
+		}
+
+		// status messages
+		if (hud.gameState == Won) {
+			writeCentred(sxScreenWidth / 2, syScreenHeight / 2, "You made it!");
+			writeCentred(sxScreenWidth / 2, syScreenHeight / 2 + letterSize, "Press F for menu");
+		}
+		if (hud.gameState == Drowning) {
+			writeCentred(sxScreenWidth / 2, syScreenHeight / 2, "Oops...");
+			writeCentred(sxScreenWidth / 2, syScreenHeight / 2 + letterSize, "Press F for menu");
+		}
+		if (hud.gameState == Normal && hud.tideMessage) {
+			writeCentred(sxScreenWidth / 2, syScreenHeight / 2, "The tide is coming in!");
+		}
+
+		// sand running behind real time
+		if (hud.lag > 0) {
+			DrawString(1, 1, "sand lag " + std::to_string(hud.lag), olc::DARK_BLUE);
+		}
+	}
+
+	void FillBucket(olc::Pixel pixel) {
+		FillRect(sxScreenWidth - sxBucketWidth + 1, syBeachMax + 1, sxBucketWidth - 2, syBucketHeight - 1, pixel);
+	}
+
+	void FillKey(int x, int y, olc::Pixel pixel, std::string letter, bool valid) {
+		DrawRect(x, y, sxKeyWidth, syKeyHeight, olc::GREY);
+		if (valid) {
+			FillRect(x + 1, y + 1, sxKeyWidth - 1, syKeyHeight - 1, pixel);
+			DrawString(x + (sxKeyWidth - 1) / 2 - letterSize / 2 + 1, y + (syKeyHeight - 1) / 2 - letterSize / 2 + 1, letter);
+		}
+		else {
+			DrawString(x + (sxKeyWidth - 1) / 2 - letterSize / 2 + 1, y + (syKeyHeight - 1) / 2 - letterSize / 2 + 1, letter, olc::GREY);
+		}
+	}
+
+	void writeCentred(int x, int y, std::string s) {
+		int left = x - letterSize*s.length()/2 - 1;
+		int up = y - letterSize / 2 - 1;
+		DrawString(left, up, s);
+	}
+
+	void dropLadder() {
+		looseLadders.add(olc::vf2d(
+			sxPlayerX + sxPlayerWidth / 2 - sxCellsOffset / 2,
+			syPlayerY - syCellHeight / 4 + 1
+		));
+	}
+
+	void drawBeach() {
+		FillRect(0, syBeachMax, sxScreenWidth, syScreenHeight - syBeachMax, olc::DARK_YELLOW);
+		DrawLine(0, syBeachMax, sxScreenWidth - 1, syBeachMax, olc::VERY_DARK_YELLOW);
+	}
+
+	// Sky, sun, beach, cliffs and wood pile never change bar the sun's colour, so they're
+	// baked into the scenery layer behind the particles. Only the sun reaches into the
+	// particle field; sand covers it there as it always did, and the particle layer is
+	// cleared to BLANK elsewhere so the sun shows through.
+	void drawScenery(olc::Pixel sunColour) {
+		if (sunColour == sceneryBakedSun) return;
+		sceneryBakedSun = sunColour;
+		SetDrawTarget(sceneryLayer, true);
+		Clear(olc::CYAN);
+		FillCircle(sxScreenWidth - sSunRadius - 1, sSunRadius, sSunRadius, sunColour);
+		drawBeach();
+		drawCliffs();
+		drawWoodPile();
+		SetDrawTarget(nullptr);
+	}
+
+	// Particles are written straight into their layer a row at a time, colours looked
+	// up by Particle value; no particle leaves the row clear. Only rows the engine says
+	// changed are redrawn, and the layer is only uploaded again if any were.
+	void drawParticles() {
+		uint64_t changed[ParticleChunks::nRowWords];
+		if (!particles.takeChangedRows(changed)) return;
+		SetDrawTarget(particleLayer, true);
+		olc::Sprite* target = GetDrawTarget();
+		int nx = std::min(nxParticles, int(target->width) - sxCellsOffset);
+		int ny = std::min(nyParticles, int(target->height));
+		uint8_t scratch[nxParticles];
+		for (int sy = 0; sy < ny; sy++) {
+			if (!(changed[sy / 64] & (uint64_t(1) << (sy % 64)))) continue;
+			olc::Pixel* out = target->GetData() + sy * target->width;
+			std::fill(out, out + target->width, olc::BLANK);
+			blitParticles(particles.rowBytes(sy, scratch), out + sxCellsOffset, nx);
+		}
+		SetDrawTarget(nullptr);
 	}
 
-	void drawBeach() {
-		FillRect(0, syBeachMax, sxScreenWidth, syScreenHeight - syBeachMax, olc::DARK_YELLOW);
-		DrawLine(0, syBeachMax, sxScreenWidth - 1, syBeachMax, olc::VERY_DARK_YELLOW);
+	static const uint32_t* particleColours() {
+		static const uint32_t colours[8] = { 0, olc::YELLOW.n, olc::DARK_YELLOW.n };
+		return colours;
 	}
 
-	void drawParticles() {
-		for (int sx = 0; sx < nxParticles; sx++) {
-			for (int sy = 0; sy < nyParticles; sy++) {
-				switch (particles[sy][sx]) {
-				case DrySand:
-					Draw(sxCellsOffset + sx, sy, olc::YELLOW);
-					break;
-				case DampSand:
-					Draw(sxCellsOffset + sx, sy, olc::DARK_YELLOW);
-					break;
-				}
-			}
+	static void blitParticles(const uint8_t* p, olc::Pixel* out, int n) {
+		const uint32_t* colours = particleColours();
+		int x = 0;
+#if defined(BEACH_AVX2_DISPATCH)
+		static const bool avx2 = __builtin_cpu_supports("avx2");
+		if (avx2) x = blitParticlesAvx2(p, out, n);
+#endif
+#if defined(__SSE2__)
+		// four pixels at a time, a mask per kind of particle
+		const __m128i dry = _mm_set1_epi32(DrySand);
+		const __m128i damp = _mm_set1_epi32(DampSand);
+		const __m128i dryColour = _mm_set1_epi32(int(colours[DrySand]));
+		const __m128i dampColour = _mm_set1_epi32(int(colours[DampSand]));
+		const __m128i zero = _mm_setzero_si128();
+		for (; x + 4 <= n; x += 4) {
+			uint32_t four;
+			std::memcpy(&four, p + x, 4);
+			__m128i kind = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(int(four)), zero), zero);
+			__m128i isDry = _mm_cmpeq_epi32(kind, dry);
+			__m128i isDamp = _mm_cmpeq_epi32(kind, damp);
+			__m128i behind = _mm_andnot_si128(_mm_or_si128(isDry, isDamp), _mm_loadu_si128((const __m128i*)(out + x)));
+			__m128i colour = _mm_or_si128(_mm_and_si128(isDry, dryColour), _mm_and_si128(isDamp, dampColour));
+			_mm_storeu_si128((__m128i*)(out + x), _mm_or_si128(colour, behind));
 		}
+#endif
+		for (; x < n; x++) {
+			if (p[x] != NoParticle) out[x].n = colours[p[x]];
+		}
+	}
+
+#if defined(BEACH_AVX2_DISPATCH)
+	// eight pixels at a time, the colour table held in a register and indexed by permute
+	__attribute__((target("avx2")))
+	static int blitParticlesAvx2(const uint8_t* p, olc::Pixel* out, int n) {
+		const __m256i colours = _mm256_loadu_si256((const __m256i*)particleColours());
+		const __m256i none = _mm256_set1_epi32(NoParticle);
+		int x = 0;
+		for (; x + 8 <= n; x += 8) {
+			__m256i kind = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(p + x)));
+			__m256i colour = _mm256_permutevar8x32_epi32(colours, kind);
+			__m256i behind = _mm256_loadu_si256((const __m256i*)(out + x));
+			__m256i empty = _mm256_cmpeq_epi32(kind, none);
+			_mm256_storeu_si256((__m256i*)(out + x), _mm256_blendv_epi8(colour, behind, empty));
+		}
+		return x;
 	}
+#endif
 
 	void drawFullCellTops() {
 		for (int y = 0; y < nyCells; y++) {
@@ -395,10 +2651,10 @@ private:
 		}
 	}
 
-	void drawPlayer() {
-		FillRect(sxPlayerX, syPlayerY - syPlayerHeight + 1, sxPlayerWidth, syPlayerHeight, olc::Pixel(210, 169, 161));
-		FillRect(sxPlayerX, syPlayerY - syPlayerHeight * 7 / 16 + 1, sxPlayerWidth, syPlayerHeight * 5 / 16, olc::MAGENTA);
-		FillRect(sxPlayerX, syPlayerY - syPlayerHeight + 1, sxPlayerWidth, syCrenelHeight / 4, brown);
+	void drawPlayer(float sx, float sy) {
+		FillRect(sx, sy - syPlayerHeight + 1, sxPlayerWidth, syPlayerHeight, olc::Pixel(210, 169, 161));
+		FillRect(sx, sy - syPlayerHeight * 7 / 16 + 1, sxPlayerWidth, syPlayerHeight * 5 / 16, olc::MAGENTA);
+		FillRect(sx, sy - syPlayerHeight + 1, sxPlayerWidth, syCrenelHeight / 4, brown);
 	}
 
 	// draw crenellations below player
@@ -413,74 +2669,116 @@ private:
 		}
 	}
 
+	// The sea is see-through. Over something already drawn on layer 0 it's blended
+	// there, as the ALPHA pixel mode does; over a clear pixel it's left translucent so
+	// the particle and sky layers behind show through when the layers are composed.
+	static olc::Pixel seaOver(int, int, const olc::Pixel& sea, const olc::Pixel& under) {
+		const float a = 0.7f;
+		if (under.a == 0) return olc::Pixel(sea.r, sea.g, sea.b, uint8_t(a * 255));
+		return olc::Pixel(
+			uint8_t(a * sea.r + (1.0f - a) * under.r),
+			uint8_t(a * sea.g + (1.0f - a) * under.g),
+			uint8_t(a * sea.b + (1.0f - a) * under.b)
+		);
+	}
+
 	void drawSea(int sySeaLevel) {
-		SetPixelBlend(0.7f);
-		SetPixelMode(olc::Pixel::ALPHA);
+		SetPixelMode(seaOver);
 		FillRect(0, sySeaLevel, sxScreenWidth, syScreenHeight - sySeaLevel, olc::BLUE);
 		SetPixelMode(olc::Pixel::NORMAL);
 	}
 
-public:
-	bool OnUserCreate() override
-	{
-		resetGameVariables(true);
-		return true;
+	bool canGetSand = false;
+	bool canGetWater = false;
+	bool canGetWood = false;
+	bool canDump = false;
+
+	// keys seen by the simulation: the engine's own when windowed, held over until the
+	// next step so a frame without one loses no presses and a frame with several doesn't
+	// repeat them; a scripted set when stepped by the headless driver
+	bool scriptedInput = false;
+	bool scriptedKeyNewState[olc::Key::ENUM_END] = { 0 };
+	bool scriptedKeyOldState[olc::Key::ENUM_END] = { 0 };
+	olc::HWButton scriptedKeyState[olc::Key::ENUM_END];
+	olc::HWButton stepKeyState[olc::Key::ENUM_END];
+
+	olc::HWButton key(olc::Key k) const {
+		return scriptedInput ? scriptedKeyState[k] : stepKeyState[k];
 	}
 
-	bool OnUserUpdate(float fElapsedTime) override
-	{
-		if (gameState == Menu) {
-			Clear(olc::CYAN);
-			drawBeach();
-			FillCircle(sxScreenWidth - sSunRadius - 1, sSunRadius, sSunRadius, olc::YELLOW);
-			drawParticles();
-			drawFullCellTops();
-			drawCliffs();
-			drawWoodPile();
-			drawCrenelsBehindPlayer();
-			drawPlayer();
-			drawCrenelsBeforePlayer();
-			int sySeaLevel = int(wySeaLevel * syScreenHeight);
-			drawSea(sySeaLevel);
-			writeCentred(sxScreenWidth/2, syScreenHeight/2 - letterSize*3, "Beach Weather");
-			writeCentred(sxScreenWidth/2, syScreenHeight/2, "F to start");
-			if (GetKey(olc::Key::F).bPressed) {
-				gameState = Normal;
-				resetGameVariables(false);
-			}
-			return(true);
+	void latchKeys() {
+		for (int k = 0; k < olc::Key::ENUM_END; k++) {
+			olc::HWButton b = GetKey(olc::Key(k));
+			stepKeyState[k].bPressed |= b.bPressed;
+			stepKeyState[k].bReleased |= b.bReleased;
+			stepKeyState[k].bHeld = b.bHeld;
 		}
+	}
 
-		Clear(olc::CYAN);
+	void clearKeyEdges() {
+		for (int k = 0; k < olc::Key::ENUM_END; k++) {
+			stepKeyState[k].bPressed = false;
+			stepKeyState[k].bReleased = false;
+		}
+	}
 
-		if (seaRising && wySeaLevel > 0) wySeaLevel -= wdySeaRiseRate * fElapsedTime;
+	// A sweep can be spread over frames: the slice the current one has reached, or -1
+	// between sweeps. Each frame may sweep until the deadline, which is far off when
+	// there's no budget.
+	int sweepCursor = -1;
+	int sweepBudget = sweepBudgetMicros;
+	std::chrono::steady_clock::time_point sweepDeadline = std::chrono::steady_clock::time_point::max();
+
+	// sweeps owed, counting what's left of one under way
+	float sweepLag() const {
+		float owed = particleMoveCharge;
+		if (sweepCursor >= 0) owed += 1.0f - float(sweepCursor) / float(particles.sweepSlices());
+		return owed;
+	}
+
+	// time not yet simulated, and where things were before the last step, to draw them
+	// part way between
+	float stepAccumulator = 0.0f;
+	float sxLastPlayerX;
+	float syLastPlayerY;
+
+	void rememberPositions() {
+		sxLastPlayerX = sxPlayerX;
+		syLastPlayerY = syPlayerY;
+		looseLadders.beginStep();
+	}
+
+	void drawMenu() {
+		drawScenery(olc::YELLOW);
+		drawParticles();
+		Clear(olc::BLANK);
+		drawFullCellTops();
+		drawCrenelsBehindPlayer();
+		drawPlayer(sxPlayerX, syPlayerY);
+		drawCrenelsBeforePlayer();
 		int sySeaLevel = int(wySeaLevel * syScreenHeight);
+		drawSea(sySeaLevel);
+		drawHud();
+	}
 
-		// sunburn event timer
-		sunburnEventCharge += fElapsedTime * sunburnEventRate;
-		if (sunburnEventCharge >= 1.0f) {
-			std::vector<olc::vi2d> burnable;
-			for (int x = 0; x < nxCells; x++) {
-				for (int y = 0; y < nyCells; y++) {
-					if (castleGrid[y][x] == FullDampCell && syCellHeight * (y + 1) - 1 < sySeaLevel) {
-						burnable.push_back(olc::vi2d(x, y));
-					}
-				}
-			}
+	void weatherEvent(const EventQueue::Event& e, int sySeaLevel) {
+		switch (e.kind) {
+		case SunburnEvent: {
+			// damp cells entirely above the sea
+			int cyAboveSea = std::min(std::max(sySeaLevel, 0) / syCellHeight, nyCells);
+			CellSet burnable = dampCells & CellSet::rowsAbove(cyAboveSea);
 			// apply sunburn to five damp cells
 			int n_burnable = burnable.size();
 			int to_burn = 5;
-			for (auto& pos : burnable) {
+			for (int i = burnable.next(0); i >= 0; i = burnable.next(i + 1)) {
+				int cx = i / nyCells;
+				int cy = i % nyCells;
 				float prob = std::min(float(to_burn) / float(n_burnable), 1.0f);
-				if (float(std::rand()) / float(RAND_MAX) < prob) {
-					bool inBurns = std::find(
-						sunburnLocations.begin(),
-						sunburnLocations.end(),
-						olc::vi2d(pos.x, pos.y)
-					) != sunburnLocations.end();
-					if (!inBurns) {
-						sunburnLocations.push_back(olc::vi2d(pos.x, pos.y));
-						sunburnTimes.push_back(sunburnTime);
+				if (sunburnRandom.unit() < prob) {
+					if (!burningCells.contains(cx, cy)) {
+						burningCells.insert(cx, cy);
+						burnEnds[cy][cx] = playTime + sunburnTime;
+						burnEvents.schedule(burnEnds[cy][cx], BurnOutEvent, i);
 						to_burn -= 1;
 					}
 				}
@@ -489,216 +2787,132 @@ public:
 					break;
 				}
 			}
-
-			while (sunburnEventCharge >= 1.0f) {
-				sunburnEventCharge -= 1.0f;
-			}
+			weatherEvents.schedule(e.time + 1.0 / sunburnEventRate, SunburnEvent);
+			break;
 		}
-
-		// wind event stop timer
-		if (wind) {
-			windEventStopCharge += fElapsedTime;
-			if (windEventStopCharge >= windEventDuration) {
-				wind = false;
-				windEventStopCharge = 0.0f;
+		case RainEvent:
+			raining = true;
+			weatherEvents.schedule(e.time + 1.0 / windEventRate, WindEvent);
+			break;
+		case WindEvent:
+			// a gust while it's already windy only turns the wind
+			if (!wind) {
+				weatherEvents.schedule(e.time + windEventDuration, WindStopEvent);
+				weatherEvents.schedule(e.time + 1.0 / windWoodPushRate, WoodPushEvent, windGeneration);
 			}
-		}
-
-		// wind event timer
-		if (raining) {
-			windEventCharge += fElapsedTime * windEventRate;
-			if (windEventCharge >= 1.0f) {
-				wind = true;
-				windVelocity = windVelocity * float(1 - 2 * (std::rand() % 2));
-				windEventCharge -= 1.0f;
+			wind = true;
+			windVelocity = windVelocity * float(1 - 2 * windRandom.bit());
+			weatherEvents.schedule(e.time + 1.0 / windEventRate, WindEvent);
+			break;
+		case WindStopEvent:
+			wind = false;
+			windGeneration++;
+			break;
+		case WoodPushEvent:
+			// wind pushes floating ladders
+			if (e.arg == windGeneration) {
+				looseLadders.push(windVelocity);
+				weatherEvents.schedule(e.time + 1.0 / windWoodPushRate, WoodPushEvent, windGeneration);
 			}
+			break;
+		case TideEvent:
+			seaRising = true;
+			displayingTideEvent = true;
+			weatherEvents.schedule(e.time + tideEventDisplayTime, TideMessageEndEvent);
+			break;
+		case TideMessageEndEvent:
+			displayingTideEvent = false;
+			break;
+		case BurnOutEvent:
+			// never scheduled here: burns go on burnEvents, checked in updateWorld
+			break;
 		}
+	}
 
-		// rain event timer
-		if (!raining) {
-			rainTimer += fElapsedTime;
-			if (rainTimer >= timeToRain) {
-				raining = true;
+	// advance the world by fElapsedTime, without drawing anything
+	void updateWorld(float fElapsedTime) {
+		if (gameState == Menu) {
+			if (key(olc::Key::F).bPressed) {
+				gameState = Normal;
+				resetGameVariables(false);
 			}
+			return;
 		}
 
-		// tide event timer
-		if (tideCounting) {
-			tideTimer += fElapsedTime;
-			if (tideTimer >= timeToTide) {
-				tideCounting = false;
-				seaRising = true;
-				displayingTideEvent = true;
-			}
-		}
+		if (seaRising && wySeaLevel > 0) wySeaLevel -= wdySeaRiseRate * fElapsedTime;
+		int sySeaLevel = int(wySeaLevel * syScreenHeight);
 
-		// tide event display timer
-		if (displayingTideEvent) {
-			tideEventDisplayTimer += fElapsedTime;
-			if (tideEventDisplayTimer >= tideEventDisplayTime) {
-				displayingTideEvent = false;
-			}
+		worldTime += fElapsedTime;
+		EventQueue::Event e;
+		while (weatherEvents.pop(worldTime, e)) {
+			weatherEvent(e, sySeaLevel);
 		}
 
-		// sunburn timer
+		// burning cells dry out
 		if (gameState != Won) {
-			for (int n = 0; n < sunburnLocations.size();) {
-				sunburnTimes[n] -= fElapsedTime;
-				if (sunburnTimes[n] <= 0.0f) {
-					olc::vi2d cell = sunburnLocations[n];
-
-					castleGrid[cell.y][cell.x] = NonFullCell; // dry out cell here, removing now for placeholder
-					for (int x = cell.x * sxCellWidth; x < (cell.x + 1) * sxCellWidth; x++) {
-						for (int y = cell.y * syCellHeight; y < (cell.y + 1) * syCellHeight; y++) {
-							particles[y][x] = DrySand;
-						}
+			playTime += fElapsedTime;
+			while (burnEvents.pop(playTime, e)) {
+				int cx = e.arg / nyCells;
+				int cy = e.arg % nyCells;
+				// events aren't cancelled: one for a burn since put out, or for an earlier
+				// burn of a cell alight again, has lapsed
+				if (!burningCells.contains(cx, cy) || burnEnds[cy][cx] != e.time) continue;
+				setCell(cx, cy, NonFullCell); // dry out cell here, removing now for placeholder
+				for (int x = cx * sxCellWidth; x < (cx + 1) * sxCellWidth; x++) {
+					for (int y = cy * syCellHeight; y < (cy + 1) * syCellHeight; y++) {
+						particles.set(x, y, DrySand);
 					}
-
-					sunburnLocations.erase(sunburnLocations.begin() + n);
-					sunburnTimes.erase(sunburnTimes.begin() + n);
-				}
-				else {
-					n++;
 				}
-			}
-		}
 
-		// loose ladders fall if not on floor, same as player
-		for (auto& pos : looseLadders) {
-			float fallDistance = syPlayerFallSpeed * fElapsedTime;
-			while (fallDistance > 0.0f) {
-				int cxLeft = floor((pos.x - sxCellsOffset) / sxCellWidth);
-				int cxRight = floor((pos.x + sxCellWidth - 1 - sxCellsOffset) / sxCellWidth);
-				int cy = floor((pos.y + syCellHeight / 4 - 1) / syCellHeight);
-				bool leftCanStand = castleGrid[cy + 1][cxLeft] == FullDampCell;
-				bool rightCanStand = castleGrid[cy + 1][cxRight] == FullDampCell;
-				bool onWorldFloor = cy == nyCells - 1;
-				bool canStand = onWorldFloor || leftCanStand || rightCanStand;
-				bool onCellFloor = (int(pos.y + syCellHeight / 4 - 1) % syCellHeight) == syCellHeight - 1;
-				bool wouldFall = !canStand || !onCellFloor;
-				if (!wouldFall || nearUpLadder || nearDownLadder) {
-					fallDistance = 0.0f;
-					break;
-				}
-				pos.y += std::min(1.0f, fallDistance);
-				fallDistance = std::max(0.0f, fallDistance - 1.0f);
+				burningCells.erase(cx, cy);
 			}
 		}
 
-		// tide raises loose ladders
-		// (if I had time, I'd split ladders into fallen and floating, to skip checks
-		// here and for falling)
-		for (auto& pos : looseLadders) {
-			if (pos.y + syCellHeight/4 > sySeaLevel) {
-				pos.y = sySeaLevel - syCellHeight/4;
-			}
-		}
+		// loose ladders fall if not on floor, same as player, and the tide raises them
+		looseLadders.update(floors, sySeaLevel, syPlayerFallSpeed * fElapsedTime, nearUpLadder || nearDownLadder);
 
 		// tide wets sand
 		int syTideWetHeight = sySeaLevel - syCrenelHeight;
-		for (int x = 0; x < nxParticles; x++) {
-			for (int y = syTideWetHeight; y < nyParticles; y++) {
-				if (particles[y][x] == DrySand) {
-					particles[y][x] = DampSand;
-				}
-			}
-		}
-
-		// wind pushes floating ladders
-		if (wind) {
-			windWoodPushCharge += windWoodPushRate * fElapsedTime;
-			while (windWoodPushCharge >= 1.0f) {
-				for (olc::vf2d& pos : looseLadders) {
-					if (pos.y == sySeaLevel - syCellHeight / 4) {
-						if (windVelocity > 0.0f && pos.x + sxCellsOffset - 1 < sxScreenWidth - 1) {
-							pos.x += 1;
-						}
-						else {
-							if (windVelocity < 0.0f && pos.x > sxCellsOffset) {
-								pos.x -= 1;
-							}
-						}
-					}
-				}
-				windWoodPushCharge -= 1.0f;
-			}
-		}
+		particles.wetFrom(syTideWetHeight);
 
 		// particles fall
 		// if wind blowing, dry sand can move to the downwind side
 		if (gameState != Won) {
 			particleMoveCharge += fElapsedTime * particleMoveRate;
 		}
-		int updateDirection;
-		while (particleMoveCharge >= 1.0f) {
-			for (int y = nyParticles - 1; y >= 0; y--) {
-				if (!wind) {
-					updateDirection = std::rand() % 2;
-				}
-				else {
-					updateDirection = int(windVelocity < 0.0f);
-				}
-				for (int x = (nxParticles - 1) * updateDirection; x >= 0 && x < nxParticles; x += 1 - 2*updateDirection) {
-					bool leftDamp = x > 0 && particles[y][x - 1] == DampSand;
-					bool rightDamp = x < nxParticles - 1 && particles[y][x + 1] == DampSand;
-					if (wind) {
-						fallPreference = 2*int(windVelocity > 0.0f) - 1;
-					}
-					else {
-						fallPreference = 2*(std::rand() % 2) - 1;
-					}
-					switch(particles[y][x]) {
-					case DrySand:
-						if (!wind) {
-							if (!swapIfEmpty(particles, x, y, x, y + 1)) {
-								if (!swapIfEmpty(particles, x, y, x + fallPreference, y + 1)) {
-									swapIfEmpty(particles, x, y, x - fallPreference, y + 1);
-								}
-							}
-						}
-						else {
-							if (!swapIfEmpty(particles, x, y, x + fallPreference, y + 1)) {
-								if (!swapIfEmpty(particles, x, y, x, y + 1)) {
-									if (!swapIfEmpty(particles, x, y, x + fallPreference, y)) {
-										swapIfEmpty(particles, x, y, x - fallPreference, y + 1);
-									}
-								}
-							}
-						}
-						break;
-					case DampSand:
-						if (y < nyParticles - 1) {
-							if (!swapIfEmpty(particles, x, y, x, y + 1)) {
-								if (!leftDamp && !rightDamp) {
-									if (!swapIfEmpty(particles, x, y, x + fallPreference, y + 1)) {
-										swapIfEmpty(particles, x, y, x - fallPreference, y + 1);
-									}
-								}
-							}
-						}
-						break;
-					case NoParticle:
-						break;
-					}
-				}
+		while (sweepCursor >= 0 || particleMoveCharge >= 1.0f) {
+			if (std::chrono::steady_clock::now() >= sweepDeadline) break;
+			if (sweepCursor < 0) {
+				particles.beginSweep(wind, windVelocity);
+				particleMoveCharge -= 1.0f;
+				sweepCursor = 0;
+			}
+			particles.sweepSlice(sweepCursor++);
+			if (sweepCursor == particles.sweepSlices()) {
+				particles.finishSweep();
+				sweepCursor = -1;
 			}
-			particleMoveCharge -= 1.0f;
 		}
 
-		// update tiles from particles
-		for (int cx = 0; cx < nxCells; cx++) {
-			for (int cy = 0; cy < nyCells; cy++) {
-				updateCellFromParticles(cx, cy);
+		// update tiles whose particle counts changed
+		uint64_t changedCells[CellCounts::nChangedWords];
+		if (particles.takeChangedCells(changedCells)) {
+			for (int w = 0; w < CellCounts::nChangedWords; w++) {
+				for (uint64_t m = changedCells[w]; m; m &= m - 1) {
+					int i = 64 * w + lowestBit(m);
+					if (i >= nxCells * nyCells) break;
+					setCell(i / nyCells, i % nyCells, particles.cell(i / nyCells, i % nyCells));
+				}
 			}
 		}
 
 		// make ladders loose if cells now empty or underwater
-		for (int l = 0; l < ladders.size(); l++) {
-			olc::vi2d pos = ladders[l];
+		for (int i = ladderCells.next(0); i >= 0; i = ladderCells.next(i + 1)) {
+			olc::vi2d pos(i / nyCells, i % nyCells);
 			bool underWater = sySeaLevel <= pos.y*syCellHeight;
 			if (castleGrid[pos.y][pos.x] == NonFullCell || underWater) {
-				looseLadders.push_back(olc::vi2d(sxCellsOffset + pos.x * sxCellWidth, (pos.y + 1)*syCellHeight - syCellHeight/4));
-				ladders.erase(ladders.begin() + l);
+				looseLadders.add(olc::vi2d(sxCellsOffset + pos.x * sxCellWidth, (pos.y + 1)*syCellHeight - syCellHeight/4));
+				ladderCells.erase(pos.x, pos.y);
 			}
 		}
 
@@ -706,15 +2920,11 @@ public:
 		bool nearTree;
 		int nearLooseLadder;
 		bool nearWater;
-		bool canGetSand;
-		bool canGetWater;
-		bool canGetWood;
-		bool canDump;
 		bool falling;
 
 		switch (gameState) {
 		case Won:
-			if (GetKey(olc::Key::F).bPressed) {
+			if (key(olc::Key::F).bPressed) {
 				resetGameVariables(true);
 				gameState = Menu;
 			}
@@ -725,7 +2935,7 @@ public:
 			falling = false;
 			break;
 		case Drowning:
-			if (GetKey(olc::Key::F).bPressed) {
+			if (key(olc::Key::F).bPressed) {
 				resetGameVariables(true);
 				gameState = Menu;
 			}
@@ -742,32 +2952,20 @@ public:
 			falling = false;
 			break;
 		case Normal:
-			if (GetKey(olc::Key::LEFT).bHeld) sxPlayerX -= sxPlayerSpeed * fElapsedTime;
-			if (GetKey(olc::Key::RIGHT).bHeld) sxPlayerX += sxPlayerSpeed * fElapsedTime;
-			if (GetKey(olc::Key::UP).bHeld && nearUpLadder) syPlayerY -= syPlayerSpeed * fElapsedTime;
-			if (GetKey(olc::Key::DOWN).bHeld && nearDownLadder) syPlayerY += syPlayerSpeed * fElapsedTime;
+			if (key(olc::Key::LEFT).bHeld) sxPlayerX -= sxPlayerSpeed * fElapsedTime;
+			if (key(olc::Key::RIGHT).bHeld) sxPlayerX += sxPlayerSpeed * fElapsedTime;
+			if (key(olc::Key::UP).bHeld && nearUpLadder) syPlayerY -= syPlayerSpeed * fElapsedTime;
+			if (key(olc::Key::DOWN).bHeld && nearDownLadder) syPlayerY += syPlayerSpeed * fElapsedTime;
 
 			// falling
-			float fallDistance = syPlayerFallSpeed * fElapsedTime;
-			bool wouldFall;
-			bool onCellFloor;
-			while (fallDistance > 0.0f) {
-				int cxPlayerLeftX = floor((sxPlayerX - sxCellsOffset) / sxCellWidth);
-				int cxPlayerRightX = floor((sxPlayerX + sxPlayerWidth - 1 - sxCellsOffset) / sxCellWidth);
-				int cyInterPlayerY = floor(syPlayerY / syCellHeight);
-				bool leftCanStand = castleGrid[cyInterPlayerY + 1][cxPlayerLeftX] == FullDampCell;
-				bool rightCanStand = castleGrid[cyInterPlayerY + 1][cxPlayerRightX] == FullDampCell;
-				bool onWorldFloor = cyInterPlayerY == nyCells - 1;
-				bool canStand = onWorldFloor || leftCanStand || rightCanStand;
-				onCellFloor = (int(syPlayerY) % syCellHeight) == syCellHeight - 1;
-				wouldFall = !canStand || !onCellFloor;
-				if (!wouldFall || nearUpLadder || nearDownLadder) {
-					fallDistance = 0.0f;
-					break;
-				}
-				syPlayerY += std::min(1.0f, fallDistance);
-				fallDistance = std::max(0.0f, fallDistance - 1.0f);
+			int cxPlayerLeftX = floor((sxPlayerX - sxCellsOffset) / sxCellWidth);
+			int cxPlayerRightX = floor((sxPlayerX + sxPlayerWidth - 1 - sxCellsOffset) / sxCellWidth);
+			int syChecked = int(syPlayerY);
+			if (!nearUpLadder && !nearDownLadder) {
+				syChecked = floors.fall(syPlayerY, syPlayerFallSpeed * fElapsedTime, cxPlayerLeftX, cxPlayerRightX, [](float y) { return int(y); });
 			}
+			bool onCellFloor = (syChecked % syCellHeight) == syCellHeight - 1;
+			bool wouldFall = !floors.onFloor(cxPlayerLeftX, cxPlayerRightX, syChecked);
 
 			// final player position / cell
 			sxPlayerX = std::max(std::min(sxPlayerX, float(sxScreenWidth - sxPlayerWidth)), 0.0f - float(sxPlayerWidth) / 2.0f);
@@ -785,34 +2983,11 @@ public:
 
 			inBounds = cxPlayerX >= 0 && cxPlayerX < nxCells&& cyPlayerY >= 0 && cyPlayerY < nyCells;
 			nearTree = (cxPlayerX == -1 && cyPlayerY == nyCells - 1);
-			nearLooseLadder = -1;
-			for (int n = 0; n < looseLadders.size(); n++) {
-				olc::vi2d pos = looseLadders[n];
-				if (
-					pos.x <= sxPlayerX + sxPlayerWidth - 1
-					&& pos.x + sxCellsOffset - 1 >= sxPlayerX
-					&& syPlayerY >= pos.y - syCrenelHeight
-					&& syPlayerY - syPlayerHeight + 1 <= pos.y + syCellHeight/4 - 1
-				) {
-					nearLooseLadder = n;
-					break;
-				}
-			}
+			nearLooseLadder = looseLadders.touching(sxPlayerX, sxPlayerX + sxPlayerWidth - 1, syPlayerY - syPlayerHeight + 1, syPlayerY);
 			// water reachable from one less than sea block-wetting distance, so starts possible
 			nearWater = (syPlayerY >= sySeaLevel - syCrenelHeight - 1);
-			bool ladderInCell = false;
-			bool ladderInBelowCell = false;
-			for (int l = 0; l < ladders.size(); l++) {
-				olc::vi2d ladder = ladders[l];
-				if (ladder.x == cxPlayerX && ladder.y == cyPlayerY) {
-					ladderInCell = true;
-					if (ladderInBelowCell) break;
-				}
-				if (ladder.x == cxPlayerX && ladder.y == cyPlayerY + 1) {
-					ladderInBelowCell = true;
-					if (ladderInCell) break;
-				}
-			};
+			bool ladderInCell = hasLadder(cxPlayerX, cyPlayerY);
+			bool ladderInBelowCell = hasLadder(cxPlayerX, cyPlayerY + 1);
 			nearUpLadder = ladderInCell;
 			nearDownLadder = (
 				ladderInCell && int(syPlayerY) % syCellHeight != syCellHeight - 1)
@@ -842,17 +3017,12 @@ public:
 					canDump = false;
 				}
 				else {
-					for (int b = 0; b < sunburnLocations.size(); b++) {
-						if (sunburnLocations[b] == olc::vi2d(cxPlayerX, cyPlayerY)) {
-							isBurning = true;
-							break;
-						}
-					}
+					isBurning = burningCells.contains(cxPlayerX, cyPlayerY);
 					canDump = castleGrid[cyPlayerY][cxPlayerX] == FullDryCell
 						|| (castleGrid[cyPlayerY][cxPlayerX] == FullDampCell && isBurning);
 				}
 			}
-			if (GetKey(olc::Key::S).bPressed && canGetSand) {
+			if (key(olc::Key::S).bPressed && canGetSand) {
 				if (bucket == BucketWater) {
 					actionState = GettingDampSand;
 				}
@@ -860,7 +3030,7 @@ public:
 					actionState = GettingSand;
 				}
 			}
-			if (GetKey(olc::Key::A).bPressed && canGetWater) {
+			if (key(olc::Key::A).bPressed && canGetWater) {
 				if (bucket == BucketSand) {
 					actionState = GettingDampSand;
 				}
@@ -868,8 +3038,8 @@ public:
 					actionState = GettingWater;
 				}
 			}
-			if (GetKey(olc::Key::W).bPressed && canGetWood) actionState = GettingWood;
-			if (GetKey(olc::Key::D).bPressed && canDump) {
+			if (key(olc::Key::W).bPressed && canGetWood) actionState = GettingWood;
+			if (key(olc::Key::D).bPressed && canDump) {
 				switch (bucket) {
 				case BucketSand:
 					actionState = PouringSand;
@@ -911,17 +3081,17 @@ public:
 				}
 				bucket = BucketWood;
 				if (!nearTree) {
-					looseLadders.erase(looseLadders.begin() + nearLooseLadder);
+					looseLadders.remove(nearLooseLadder);
 				}
 				break;
 			case PouringSand:
 				switch (castleGrid[cyPlayerY][cxPlayerX]) {
 				case NonFullCell:
-					castleGrid[cyPlayerY][cxPlayerX] = FullDryCell;
+					setCell(cxPlayerX, cyPlayerY, FullDryCell);
 					for (int x = cxPlayerX * sxCellWidth; x < (cxPlayerX + 1) * sxCellWidth; x++) {
 						for (int y = cyPlayerY * syCellHeight; y < (cyPlayerY + 1) * syCellHeight; y++) {
-							if (particles[y][x] != DampSand) {
-								particles[y][x] = DrySand;
+							if (particles.get(x, y) != DampSand) {
+								particles.set(x, y, DrySand);
 							}
 						}
 					}
@@ -932,21 +3102,17 @@ public:
 			case PouringWater:
 				switch (castleGrid[cyPlayerY][cxPlayerX]) {
 				case FullDryCell:
-					castleGrid[cyPlayerY][cxPlayerX] = FullDampCell;
+					setCell(cxPlayerX, cyPlayerY, FullDampCell);
 					for (int x = cxPlayerX * sxCellWidth; x < (cxPlayerX + 1) * sxCellWidth; x++) {
 						for (int y = cyPlayerY * syCellHeight; y < (cyPlayerY + 1) * syCellHeight; y++) {
-							particles[y][x] = DampSand;
+							particles.set(x, y, DampSand);
 						}
 					}
 					bucket = BucketEmpty;
 				case FullDampCell:
-					for (int b = 0; b < sunburnLocations.size(); b++) {
-						if (sunburnLocations[b] == olc::vi2d(cxPlayerX, cyPlayerY)) {
-							sunburnLocations.erase(sunburnLocations.begin() + b);
-							sunburnTimes.erase(sunburnTimes.begin() + b);
-							bucket = BucketEmpty;
-							break;
-						}
+					if (burningCells.contains(cxPlayerX, cyPlayerY)) {
+						burningCells.erase(cxPlayerX, cyPlayerY);
+						bucket = BucketEmpty;
 					}
 				}
 				break;
@@ -954,10 +3120,10 @@ public:
 				switch (castleGrid[cyPlayerY][cxPlayerX]) {
 				case NonFullCell:
 				case FullDryCell:
-					castleGrid[cyPlayerY][cxPlayerX] = FullDampCell;
+					setCell(cxPlayerX, cyPlayerY, FullDampCell);
 					for (int x = cxPlayerX * sxCellWidth; x < (cxPlayerX + 1) * sxCellWidth; x++) {
 						for (int y = cyPlayerY * syCellHeight; y < (cyPlayerY + 1) * syCellHeight; y++) {
-							particles[y][x] = DampSand;
+							particles.set(x, y, DampSand);
 						}
 					}
 					bucket = BucketEmpty;
@@ -965,21 +3131,14 @@ public:
 				}
 				break;
 			case SettingLadder:
-				bool hasLadder = false;
 				switch (castleGrid[cyPlayerY][cxPlayerX]) {
 				case FullDryCell:
 				case FullDampCell:
-					for (olc::vi2d& pos : ladders) {
-						if (pos.x == cxPlayerX && pos.y == cyPlayerY) {
-							hasLadder = true;
-							break;
-						}
-					}
-					if (hasLadder) {
+					if (hasLadder(cxPlayerX, cyPlayerY)) {
 						dropLadder();
 					}
 					else {
-						ladders.push_back({ cxPlayerX, cyPlayerY });
+						ladderCells.insert(cxPlayerX, cyPlayerY);
 					}
 					bucket = BucketEmpty;
 					break;
@@ -994,165 +3153,317 @@ public:
 			break;
 		}
 
-		// draw sun, hotter if any blocks burning
-		if (sunburnLocations.size() > 0) {
-			FillCircle(sxScreenWidth - sSunRadius - 1, sSunRadius, sSunRadius, olc::RED);
-		}
-		else {
-			FillCircle(sxScreenWidth - sSunRadius - 1, sSunRadius, sSunRadius, olc::YELLOW);
+		// rainfall
+		raindrops.step(wind ? windVelocity * fElapsedTime : 0.0f, rainFallSpeed*fElapsedTime, wySeaLevel, wxMinRainX, wxMaxRainX);
+		if (raining) {
+			rainCharge += fElapsedTime*rainRate;
+			while (rainCharge >= 1.0f) {
+				float wxNewX = wxMinRainX + (wxMaxRainX - wxMinRainX)*rainRandom.unit();
+				raindrops.add(wxNewX, 0.0f);
+				rainCharge -= 1.0f;
+			}
 		}
+	}
 
-		drawBeach();
+	// alpha is how far the frame is from the last step to the next one
+	void drawWorld(float alpha) {
+		int sySeaLevel = int(wySeaLevel * syScreenHeight);
+
+		// scenery behind, with the sun hotter if any blocks burning
+		drawScenery(burningCells.empty() ? olc::YELLOW : olc::RED);
 
 		drawParticles();
 
+		Clear(olc::BLANK);
+
 		drawFullCellTops();
 
 		// redraw cells drying out
-		for (int n = 0; n < sunburnLocations.size(); n++) {
-			olc::vi2d pos = sunburnLocations[n];
-			float time = sunburnTimes[n];
+		for (int i = burningCells.next(0); i >= 0; i = burningCells.next(i + 1)) {
+			olc::vi2d pos(i / nyCells, i % nyCells);
+			float time = float(burnEnds[pos.y][pos.x] - playTime);
 			olc::Pixel col = olc::PixelLerp(olc::YELLOW, olc::DARK_YELLOW, time / sunburnTime);
 			FillRect(sxCellsOffset + sxCellWidth * pos.x, syCellHeight* pos.y, sxCellWidth, syCellHeight, col);
 			DrawLine(sxCellsOffset + sxCellWidth * pos.x, syCellHeight* pos.y, sxCellsOffset + sxCellWidth * (pos.x + 1) - 1, syCellHeight* pos.y, olc::VERY_DARK_YELLOW);
 		}
 		// draw ladders
-		for (int l = 0; l < ladders.size(); l++) {
-			olc::vi2d pos = ladders[l];
-			int x = pos.x;
-			int y = pos.y;
-			DrawLine(sxCellsOffset + sxCellWidth * x + sxLadderOffset, syCellHeight * y + 1, sxCellsOffset + sxCellWidth * x + sxLadderOffset, syCellHeight* (y + 1) - 1, brown);
-			DrawLine(sxCellsOffset + sxCellWidth * (x + 1) - sxLadderOffset - 1, syCellHeight* y + 1, sxCellsOffset + sxCellWidth * (x + 1) - sxLadderOffset - 1, syCellHeight* (y + 1) - 1, brown);
-			DrawLine(sxCellsOffset + sxCellWidth * x + sxLadderOffset, syCellHeight*y + syCrenelHeight, sxCellsOffset + sxCellWidth * (x + 1) - sxLadderOffset - 1, syCellHeight* y + syCrenelHeight, brown);
-			DrawLine(sxCellsOffset + sxCellWidth * x + sxLadderOffset, syCellHeight* y + 2 * syCrenelHeight, sxCellsOffset + sxCellWidth * (x + 1) - sxLadderOffset - 1, syCellHeight* y + 2 * syCrenelHeight, brown);
-			DrawLine(sxCellsOffset + sxCellWidth * x + sxLadderOffset, syCellHeight*y + 3*syCrenelHeight, sxCellsOffset + sxCellWidth * (x + 1) - sxLadderOffset - 1, syCellHeight*y + 3*syCrenelHeight, brown);
+		for (int i = ladderCells.next(0); i >= 0; i = ladderCells.next(i + 1)) {
+			drawLadder(sxCellsOffset + sxCellWidth * (i / nyCells), syCellHeight * (i % nyCells));
 		}
 
 		// draw fire effect on cells drying out
-		for (int n = 0; n < sunburnLocations.size(); n++) {
-			olc::vi2d pos = sunburnLocations[n];
+		for (int i = burningCells.next(0); i >= 0; i = burningCells.next(i + 1)) {
+			olc::vi2d pos(i / nyCells, i % nyCells);
 			FillRect(sxCellsOffset + sxCellWidth * pos.x, syCellHeight * pos.y + 3*syCrenelHeight, sxCellWidth, syCrenelHeight, olc::RED);
 		}
 
-		drawCliffs();
-
-		drawWoodPile();
-
-		// draw loose ladders
-		for (auto& pos : looseLadders) {
+		// draw loose ladders, between steps
+		for (int n = 0; n < looseLadders.size(); n++) {
+			olc::vf2d pos = looseLadders.drawnAt(n, alpha);
 			FillRect(pos.x, pos.y, sxCellsOffset, syCellHeight / 4, brown);
 			DrawRect(pos.x, pos.y, sxCellsOffset - 1, syCellHeight / 4 - 1, olc::BLACK);
 		}
 
 		drawCrenelsBehindPlayer();
 
-		drawPlayer();
+		drawPlayer(sxLastPlayerX + (sxPlayerX - sxLastPlayerX) * alpha, syLastPlayerY + (syPlayerY - syLastPlayerY) * alpha);
 
 		drawCrenelsBeforePlayer();
 
 		drawSea(sySeaLevel);
 
-		// rainfall
-		if (wind) {
-			for (auto& x : wxRaindropsX) {
-				x += windVelocity * fElapsedTime;
-			}
+		// raindrops fall in straight lines, so back them up along their step
+		float wdxRainStep = wind ? windVelocity * simStepTime : 0.0f;
+		float wdyRainStep = rainFallSpeed * simStepTime;
+		for (int n = 0; n < raindrops.size(); n++) {
+			float wx = raindrops.x(n) - wdxRainStep * (1.0f - alpha);
+			float wy = raindrops.y(n) - wdyRainStep * (1.0f - alpha);
+			FillRect(wx*sxScreenWidth, wy*syScreenHeight, 4/pixels, 4/pixels, olc::BLUE);
 		}
-		for (auto& y : wyRaindropsY) {
-			y += rainFallSpeed*fElapsedTime;
+
+		drawHud();
+	}
+
+public:
+	bool OnUserCreate() override
+	{
+#if !defined(OLC_PGE_HEADLESS)
+		particleLayer = uint8_t(CreateLayer());
+		sceneryLayer = uint8_t(CreateLayer());
+		EnableLayer(particleLayer, true);
+		EnableLayer(sceneryLayer, true);
+		// layers start opaque black, and rows with no particles are never redrawn, so
+		// the scenery would never show through them
+		SetDrawTarget(particleLayer);
+		Clear(olc::BLANK);
+		SetDrawTarget(nullptr);
+		makeStamps();
+		hudPicture.Create(sxScreenWidth, syScreenHeight);
+#endif
+		resetGameVariables(true);
+		return true;
+	}
+
+	bool OnUserUpdate(float fElapsedTime) override
+	{
+		latchKeys();
+		if (sweepBudget > 0) {
+			sweepDeadline = std::chrono::steady_clock::now() + std::chrono::microseconds(sweepBudget);
 		}
-		for (int n = 0; n < wxRaindropsX.size(); n++) {
-			if (wyRaindropsY[n] > wySeaLevel || wxRaindropsX[n] < wxMinRainX || wxRaindropsX[n] > wxMaxRainX) {
-				wxRaindropsX.erase(wxRaindropsX.begin() + n);
-				wyRaindropsY.erase(wyRaindropsY.begin() + n);
-			}
+		else {
+			sweepDeadline = std::chrono::steady_clock::time_point::max();
 		}
-		if (raining) {
-			rainCharge += fElapsedTime*rainRate;
-			while (rainCharge >= 1.0f) {
-				float wxNewX = wxMinRainX + (wxMaxRainX - wxMinRainX)*std::rand() / float(RAND_MAX);
-				int sxNewX = floor(sxScreenWidth * wxNewX);
-				wxRaindropsX.push_back(wxNewX);
-				wyRaindropsY.push_back(0.0);
-				rainCharge -= 1.0f;
-			}
+		stepAccumulator += fElapsedTime;
+		int steps = 0;
+		while (stepAccumulator >= simStepTime && steps < maxStepsPerFrame) {
+			rememberPositions();
+			updateWorld(simStepTime);
+			clearKeyEdges();
+			stepAccumulator -= simStepTime;
+			steps++;
 		}
-		for (int n = 0; n < wxRaindropsX.size(); n++) {
-			float wx = wxRaindropsX[n];
-			float wy = wyRaindropsY[n];
-			FillRect(wx*sxScreenWidth, wy*syScreenHeight, 4/pixels, 4/pixels, olc::BLUE);
+		// behind by more than the cap: drop the backlog rather than carry it
+		stepAccumulator = std::min(stepAccumulator, simStepTime);
+		if (gameState == Menu) {
+			drawMenu();
 		}
-
-		// draw controls UI
-		switch (bucket) {
-		case BucketEmpty:
-			FillKey(0, syScreenHeight - syKeyHeight - 1, olc::BLUE, "A", canGetWater);
-			FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - syKeyHeight - 1, olc::YELLOW, "S", canGetSand);
-			break;
-		case BucketSand:
-			FillKey(0, syScreenHeight - syKeyHeight - 1, olc::DARK_YELLOW, "A", canGetWater);
-			FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - syKeyHeight - 1, olc::YELLOW, "S", canGetSand);
-			break;
-		case BucketDampSand:
-			FillKey(0, syScreenHeight - syKeyHeight - 1, olc::BLUE, "A", canGetWater);
-			FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - syKeyHeight - 1, olc::YELLOW, "S", canGetSand);
-			break;
-		case BucketWater:
-			FillKey(0, syScreenHeight - syKeyHeight - 1, olc::BLUE, "A", canGetWater);
-			FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - syKeyHeight - 1, olc::DARK_YELLOW, "S", canGetSand);
-			break;
-		case BucketWood:
-			FillKey(0, syScreenHeight - syKeyHeight - 1, olc::BLUE, "A", canGetWater);
-			FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - syKeyHeight - 1, olc::YELLOW, "S", canGetSand);
-			break;
+		else {
+			drawWorld(stepAccumulator / simStepTime);
 		}
-		FillKey(sxKeyWidth + sKeySpacing, syScreenHeight - 2 * syKeyHeight - sKeySpacing - 1, brown, "W", canGetWood);
-		FillKey(2 * (sxKeyWidth + sKeySpacing), syScreenHeight - syKeyHeight - 1, olc::CYAN, "D", canDump);
+		return true;
+	}
 
-		// draw bucket UI
-		FillRect(sxScreenWidth - sxBucketWidth, syBeachMax + 1, sxBucketWidth, syBucketHeight, olc::GREY);
-		switch(bucket) {
-		case BucketEmpty:
-			FillBucket(olc::CYAN);
-			break;
-		case BucketSand:
-			FillBucket(olc::YELLOW);
-			break;
-		case BucketWater:
-			FillBucket(olc::DARK_BLUE);
-			break;
-		case BucketDampSand:
-			FillBucket(olc::DARK_YELLOW);
-			break;
-		case BucketWood:
-			FillBucket(brown);
-			break;
-		}
+	// 0 sweeps particles serially, more runs the parallel banded sweep
+	void setSweepThreads(int threads) {
+		particles.setThreads(threads);
+	}
 
-		// status messages
-		if (gameState == Won) {
-			writeCentred(sxScreenWidth / 2, syScreenHeight / 2, "You made it!");
-			writeCentred(sxScreenWidth / 2, syScreenHeight / 2 + letterSize, "Press F for menu");
-		}
-		if (gameState == Drowning) {
-			writeCentred(sxScreenWidth / 2, syScreenHeight / 2, "Oops...");
-			writeCentred(sxScreenWidth / 2, syScreenHeight / 2 + letterSize, "Press F for menu");
+	// everything random in a run follows from this
+	void setSeed(uint64_t seed) {
+		sunburnRandom = RandomStream(seed, SunburnStream);
+		windRandom = RandomStream(seed, WindStream);
+		rainRandom = RandomStream(seed, RainStream);
+		particles.setSeed(seed);
+	}
+
+	// most raindrops in the air at once, for heavier storms; drops in the air are lost
+	void setRainCapacity(int capacity) {
+		raindrops.setCapacity(capacity);
+	}
+
+	// microseconds of sweeping per frame, 0 for no limit; the headless driver has none
+	void setSweepBudget(int micros) {
+		sweepBudget = micros;
+	}
+
+	// headless driving: hold or release a key from the next tick on
+	void scriptKey(olc::Key k, bool held) {
+		scriptedInput = true;
+		scriptedKeyNewState[k] = held;
+	}
+
+	// one fixed step of the world with the scripted keys, same key edge rules as the engine
+	void tick(float fElapsedTime) {
+		if (scriptedInput) {
+			for (int k = 0; k < olc::Key::ENUM_END; k++) {
+				scriptedKeyState[k].bPressed = false;
+				scriptedKeyState[k].bReleased = false;
+				if (scriptedKeyNewState[k] != scriptedKeyOldState[k]) {
+					scriptedKeyState[k].bPressed = scriptedKeyNewState[k];
+					scriptedKeyState[k].bReleased = !scriptedKeyNewState[k];
+					scriptedKeyState[k].bHeld = scriptedKeyNewState[k];
+				}
+				scriptedKeyOldState[k] = scriptedKeyNewState[k];
+			}
 		}
-		if (gameState == Normal && displayingTideEvent) {
-			writeCentred(sxScreenWidth / 2, syScreenHeight / 2, "The tide is coming in!");
+		sweepDeadline = std::chrono::steady_clock::time_point::max();
+		updateWorld(fElapsedTime);
+	}
+
+	// FNV-1a over the particle grid and player, to compare runs
+	uint64_t checksum() const {
+		uint64_t h = 14695981039346656037ull;
+		auto mix = [&](uint64_t v) { h = (h ^ v) * 1099511628211ull; };
+		for (int y = 0; y < nyParticles; y++) {
+			for (int x = 0; x < nxParticles; x++) {
+				mix(particles.get(x, y));
+			}
 		}
+		mix(uint64_t(int(sxPlayerX)));
+		mix(uint64_t(int(syPlayerY)));
+		mix(gameState);
+		return h;
+	}
 
-		return true;
+	GameState state() const {
+		return gameState;
 	}
 
 };
 
 
+#if !defined(OLC_PGE_HEADLESS)
+
 int main()
 {
 	Game demo;
+	demo.setSeed(uint64_t(std::chrono::system_clock::now().time_since_epoch().count()));
+#if defined(BEACH_SWEEP_THREADS)
+	demo.setSweepThreads(BEACH_SWEEP_THREADS);
+#endif
+#if defined(BEACH_SWEEP_BUDGET)
+	demo.setSweepBudget(BEACH_SWEEP_BUDGET);
+#endif
+#if defined(BEACH_RAIN_CAPACITY)
+	demo.setRainCapacity(BEACH_RAIN_CAPACITY);
+#endif
 	if (demo.Construct(sxScreenWidth, syScreenHeight, pixels, pixels))
 		demo.Start();
 
 	return 0;
-}
\ No newline at end of file
+}
+
+#else
+
+// Headless driver: no window, no renderer, fixed dt, scripted keys.
+// Build the same file with -DOLC_PGE_HEADLESS (no X11/GL libraries needed), then
+//   beachweather-headless [ticks] [dt] [seed] [threads] [script]
+// where threads > 0 sweeps particles in parallel bands (0, the default, is serial).
+// A script is lines of "tick key held", e.g. "10 RIGHT 1" then "40 RIGHT 0";
+// keys are F, A, S, W, D, LEFT, RIGHT, UP, DOWN. Without one, a built-in
+// script starts a game and keeps pouring sand and water in front of the wood pile.
+
+#include <cstdio>
+
+struct ScriptedKey {
+	int tick;
+	olc::Key key;
+	bool held;
+};
+
+static bool parseKey(const std::string& name, olc::Key& k) {
+	static const std::pair<const char*, olc::Key> names[] = {
+		{ "F", olc::Key::F }, { "A", olc::Key::A }, { "S", olc::Key::S },
+		{ "W", olc::Key::W }, { "D", olc::Key::D },
+		{ "LEFT", olc::Key::LEFT }, { "RIGHT", olc::Key::RIGHT },
+		{ "UP", olc::Key::UP }, { "DOWN", olc::Key::DOWN }
+	};
+	for (auto& n : names) {
+		if (name == n.first) {
+			k = n.second;
+			return true;
+		}
+	}
+	return false;
+}
+
+static std::vector<ScriptedKey> defaultScript(int ticks) {
+	std::vector<ScriptedKey> script;
+	auto tap = [&](int tick, olc::Key k) {
+		script.push_back({ tick, k, true });
+		script.push_back({ tick + 1, k, false });
+	};
+	tap(0, olc::Key::F);
+	for (int t = 10; t < ticks; t += 40) {
+		tap(t, olc::Key::S);
+		tap(t + 10, olc::Key::D);
+		tap(t + 20, olc::Key::A);
+		tap(t + 30, olc::Key::D);
+	}
+	return script;
+}
+
+int main(int argc, char* argv[])
+{
+	int ticks = argc > 1 ? std::atoi(argv[1]) : 10000;
+	float dt = argc > 2 ? float(std::atof(argv[2])) : 1.0f / 60.0f;
+	unsigned seed = argc > 3 ? unsigned(std::atoi(argv[3])) : 1u;
+	int threads = argc > 4 ? std::atoi(argv[4]) : 0;
+
+	std::vector<ScriptedKey> script;
+	if (argc > 5) {
+		std::ifstream file(argv[5]);
+		if (!file) {
+			std::fprintf(stderr, "cannot open script %s\n", argv[5]);
+			return 1;
+		}
+		int tick;
+		std::string name;
+		int held;
+		while (file >> tick >> name >> held) {
+			olc::Key k;
+			if (!parseKey(name, k)) {
+				std::fprintf(stderr, "unknown key %s\n", name.c_str());
+				return 1;
+			}
+			script.push_back({ tick, k, held != 0 });
+		}
+	}
+	else {
+		script = defaultScript(ticks);
+	}
+	std::stable_sort(script.begin(), script.end(), [](const ScriptedKey& a, const ScriptedKey& b) { return a.tick < b.tick; });
+
+	Game demo;
+	demo.setSeed(seed);
+	demo.setSweepThreads(threads);
+	demo.OnUserCreate();
+
+	size_t next = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int t = 0; t < ticks; t++) {
+		while (next < script.size() && script[next].tick <= t) {
+			demo.scriptKey(script[next].key, script[next].held);
+			next++;
+		}
+		demo.tick(dt);
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	std::printf("ticks %d dt %g seed %u threads %d\n", ticks, dt, seed, threads);
+	std::printf("elapsed %.3fs, %.0f ticks/s\n", elapsed.count(), ticks / elapsed.count());
+	std::printf("state %d checksum %016llx\n", int(demo.state()), (unsigned long long)demo.checksum());
+	return 0;
+}
+
+#endif
\ No newline at end of file